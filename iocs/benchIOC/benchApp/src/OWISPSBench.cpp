@@ -0,0 +1,328 @@
+/*
+FILENAME...   OWISPSBench.cpp
+USAGE...      Benchmarks of the OWIS PS driver against the simulated controller
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <iocsh.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsStdio.h>
+#include <asynOctetSyncIO.h>
+
+#include <epicsExport.h>
+
+#include "OWISPSMotorDriver.h"
+#include "OWISPSSimulator.h"
+
+
+
+#define MAX_BENCH_SAMPLES    1000
+#define BENCH_LONG_MOVE      10000000 // Counter steps, long enough to keep axes moving during a poll benchmark
+#define BENCH_SHORT_MOVE     2000     // Counter steps, for the done latency benchmark
+#define BENCH_MOVES          200      // Moves issued by the throughput benchmark
+#define BENCH_DONE_MOVES     20       // Moves timed by the done latency benchmark
+#define BENCH_TIMEOUT        30.      // Seconds
+#define BENCH_PARSES         1000000  // Replies parsed by the reply parsing benchmark
+
+
+
+static int compareDouble(const void *a, const void *b) {
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da < db) ? -1 : ((da > db) ? 1 : 0);
+}
+
+/** Prints the min, mean, median, 99th percentile and max of samples given in seconds, in ms.
+  *
+  */
+static void printDistribution(const char *name, double *samples, int count) {
+    double sum = 0;
+
+    if (count <= 0) {
+        epicsStdoutPrintf("  %-28s no samples\n", name);
+        return;
+    }
+    qsort(samples, count, sizeof(double), compareDouble);
+    for (int i=0; i<count; i++) {
+        sum += samples[i];
+    }
+    epicsStdoutPrintf("  %-28s min %8.2f  mean %8.2f  p50 %8.2f  p99 %8.2f  max %8.2f ms\n", name,
+                      samples[0]*1000., sum/count*1000., samples[count/2]*1000., samples[(count*99)/100]*1000., samples[count-1]*1000.);
+}
+
+static void getStatistics(OWISPSSimulator *pSim, int& writes, int& reads, long& bytes) {
+    pSim->lock();
+    pSim->getStatistics(writes, reads, bytes);
+    pSim->unlock();
+}
+
+/** Stops all axes and polls until they are done.
+  *
+  */
+static void stopAll(OWISPSController *pC, int num_axes, int done_param, double poll_period) {
+    OWISPSAxis *axis;
+    epicsTimeStamp start, now;
+    int done;
+    bool all_done = false;
+
+    pC->lock();
+    for (int i=0; i<num_axes; i++) {
+        axis = pC->getAxis(i);
+        if (axis) {
+            axis->stop(0);
+        }
+    }
+    pC->unlock();
+
+    epicsTimeGetCurrent(&start);
+    do {
+        epicsThreadSleep(poll_period);
+        pC->pollOnce();
+        all_done = true;
+        pC->lock();
+        for (int i=0; i<num_axes; i++) {
+            done = 1;
+            pC->getIntegerParam(i, done_param, &done);
+            all_done = all_done && done;
+        }
+        pC->unlock();
+        epicsTimeGetCurrent(&now);
+    } while ((!all_done) && (epicsTimeDiffInSeconds(&now, &start) < BENCH_TIMEOUT));
+}
+
+/** Poll cycle time and round trips per cycle, for 0 up to all axes moving.
+  *
+  */
+static void benchPollCycle(OWISPSController *pC, OWISPSSimulator *pSim, int num_axes, int done_param, double poll_period, int cycles) {
+    static double samples[MAX_BENCH_SAMPLES];
+    epicsTimeStamp start, end;
+    int writes, reads;
+    long bytes;
+    char name[MAX_OWISPS_STRING_SIZE];
+
+    if (cycles > MAX_BENCH_SAMPLES) {
+        cycles = MAX_BENCH_SAMPLES;
+    }
+
+    epicsStdoutPrintf("Poll cycle time (%d cycles every %g ms):\n", cycles, poll_period*1000.);
+    for (int moving=0; moving<=num_axes; moving++) {
+        pC->lock();
+        for (int i=0; i<moving; i++) {
+            pC->getAxis(i)->move(BENCH_LONG_MOVE*((i%2) ? -1 : 1), 1, 0, 0, 0);
+        }
+        pC->unlock();
+        pC->pollOnce(); // Skip the cycle seeing the moves start
+
+        pSim->lock();
+        pSim->resetStatistics();
+        pSim->unlock();
+        for (int c=0; c<cycles; c++) {
+            epicsThreadSleep(poll_period);
+            epicsTimeGetCurrent(&start);
+            pC->pollOnce();
+            epicsTimeGetCurrent(&end);
+            samples[c] = epicsTimeDiffInSeconds(&end, &start);
+        }
+        getStatistics(pSim, writes, reads, bytes);
+
+        snprintf(name, sizeof(name), "%d/%d axes moving", moving, num_axes);
+        printDistribution(name, samples, cycles);
+        epicsStdoutPrintf("  %-28s %.2f round trips, %.2f replies, %.1f bytes per cycle\n", "",
+                          (double)writes/cycles, (double)reads/cycles, (double)bytes/cycles);
+
+        stopAll(pC, num_axes, done_param, poll_period);
+    }
+}
+
+/** Moves per second: time for the I/O thread to write a burst of move sequences.
+  *
+  */
+static void benchMoves(OWISPSController *pC, OWISPSSimulator *pSim, int num_axes, int done_param, double poll_period) {
+    epicsTimeStamp start, now;
+    int writes, reads;
+    long bytes;
+
+    pSim->lock();
+    pSim->resetStatistics();
+    pSim->unlock();
+
+    epicsTimeGetCurrent(&start);
+    for (int m=0; m<BENCH_MOVES; m++) {
+        pC->lock();
+        pC->getAxis(m % num_axes)->move((m%2) ? -1 : 1, 1, 0, 0, 0);
+        pC->unlock();
+    }
+    do {
+        epicsThreadSleep(0.001);
+        getStatistics(pSim, writes, reads, bytes);
+        epicsTimeGetCurrent(&now);
+    } while ((writes < BENCH_MOVES) && (epicsTimeDiffInSeconds(&now, &start) < BENCH_TIMEOUT));
+
+    epicsStdoutPrintf("Moves: %d written in %.1f ms, %.1f moves/s, %.1f bytes/move\n",
+                      writes, epicsTimeDiffInSeconds(&now, &start)*1000., writes/epicsTimeDiffInSeconds(&now, &start), (writes > 0) ? (double)bytes/writes : 0.);
+
+    stopAll(pC, num_axes, done_param, poll_period);
+}
+
+/** Move-to-DMOV latency: time from the move to the done flag, and beyond the nominal move time.
+  *
+  */
+static void benchDoneLatency(OWISPSController *pC, const char *simPortName, int num_axes, int done_param, double poll_period) {
+    double total[BENCH_DONE_MOVES], beyond[BENCH_DONE_MOVES];
+    epicsTimeStamp start, now;
+    asynUser *pasynUser = NULL;
+    char reply[MAX_OWISPS_STRING_SIZE];
+    size_t nwrite, nread;
+    int eom_reason, done, count = 0;
+    double velocity = 0, acceleration = 0, nominal;
+
+    if (pasynOctetSyncIO->connect(simPortName, 0, &pasynUser, NULL) == asynSuccess) {
+        if (pasynOctetSyncIO->writeRead(pasynUser, "?PVEL1", 6, reply, sizeof(reply), DEFAULT_CONTROLLER_TIMEOUT, &nwrite, &nread, &eom_reason) == asynSuccess) {
+            velocity = atof(reply);
+        }
+        if (pasynOctetSyncIO->writeRead(pasynUser, "?ACC1", 5, reply, sizeof(reply), DEFAULT_CONTROLLER_TIMEOUT, &nwrite, &nread, &eom_reason) == asynSuccess) {
+            acceleration = atof(reply);
+        }
+        pasynOctetSyncIO->disconnect(pasynUser);
+    }
+    nominal = OWISPSAxis::estimateMoveTime(BENCH_SHORT_MOVE, velocity, acceleration);
+
+    for (int m=0; m<BENCH_DONE_MOVES; m++) {
+        pC->lock();
+        epicsTimeGetCurrent(&start);
+        pC->getAxis(0)->move(BENCH_SHORT_MOVE*((m%2) ? -1 : 1), 1, 0, 0, 0);
+        pC->unlock();
+
+        do {
+            epicsThreadSleep(poll_period);
+            pC->pollOnce();
+            pC->lock();
+            pC->getIntegerParam(0, done_param, &done);
+            pC->unlock();
+            epicsTimeGetCurrent(&now);
+        } while ((!done) && (epicsTimeDiffInSeconds(&now, &start) < BENCH_TIMEOUT));
+
+        if (done) {
+            total[count] = epicsTimeDiffInSeconds(&now, &start);
+            beyond[count] = total[count] - nominal;
+            count++;
+        }
+    }
+
+    epicsStdoutPrintf("Move-to-DMOV latency (%d steps, nominal %.2f ms):\n", BENCH_SHORT_MOVE, nominal*1000.);
+    printDistribution("move to done", total, count);
+    printDistribution("beyond nominal move time", beyond, count);
+}
+
+/** Reply parsing: time per ?CNT reply, compared with atol(), and per ?ASTAT character.
+  *
+  */
+static void benchReplyParse(void) {
+    const char *replies[] = { "0", "-2500", "1000000", "-123456789" };
+    const char astat[] = "RTSPIO?WXRRTT";
+    epicsTimeStamp start, end;
+    long value, sum_parse = 0, sum_atol = 0;
+    int moving = 0;
+
+    epicsStdoutPrintf("Reply parsing (%d replies):\n", BENCH_PARSES);
+
+    epicsTimeGetCurrent(&start);
+    for (int i=0; i<BENCH_PARSES; i++) {
+        if (OWISPSAxis::updateAxisReadbackPosition(asynSuccess, replies[i%4], value, NULL)) {
+            sum_parse += value;
+        }
+    }
+    epicsTimeGetCurrent(&end);
+    epicsStdoutPrintf("  %-28s %8.1f ns/reply\n", "updateAxisReadbackPosition", epicsTimeDiffInSeconds(&end, &start)*1e9/BENCH_PARSES);
+
+    epicsTimeGetCurrent(&start);
+    for (int i=0; i<BENCH_PARSES; i++) {
+        sum_atol += atol(replies[i%4]);
+    }
+    epicsTimeGetCurrent(&end);
+    epicsStdoutPrintf("  %-28s %8.1f ns/reply\n", "atol", epicsTimeDiffInSeconds(&end, &start)*1e9/BENCH_PARSES);
+
+    epicsTimeGetCurrent(&start);
+    for (int i=0; i<BENCH_PARSES; i++) {
+        moving += (OWISPSAxis::statusFlags(astat[i%13]) & OWISPS_STATUSFLAG_MOVING) ? 1 : 0;
+    }
+    epicsTimeGetCurrent(&end);
+    epicsStdoutPrintf("  %-28s %8.1f ns/status (%d moving)\n", "statusFlags", epicsTimeDiffInSeconds(&end, &start)*1e9/BENCH_PARSES, moving);
+
+    if (sum_parse != sum_atol) { // Also keeps the loops from being optimized away
+        epicsStdoutPrintf("  parsed values differ from atol\n");
+    }
+}
+
+
+
+/** Runs all benchmarks on an OWISPSController connected to an OWISPSSimulator.
+  * The controller should be manually polled (OWISPSConfigManualPolling), so that no poller interferes:
+  * poll cycles are run by the benchmarks at the given moving poll period.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName          The name of the asyn port of the OWISPSController
+  * \param[in] simPortName       The name of the asyn port of the OWISPSSimulator
+  * \param[in] movingPollPeriod  The moving poll period to benchmark, in ms
+  * \param[in] cycles            The number of poll cycles timed for each number of moving axes
+  */
+extern "C" int OWISPSBenchmark(const char *portName, const char *simPortName, int movingPollPeriod, int cycles) {
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    OWISPSSimulator *pSim = dynamic_cast<OWISPSSimulator*>(static_cast<asynPortDriver*>(findAsynPortDriver(simPortName)));
+    int num_axes = 0, done_param;
+    double poll_period = movingPollPeriod/1000.;
+
+    if ((!pC) || (!pSim)) {
+        epicsStdoutPrintf("OWISPSBenchmark: cannot find OWIS PS controller %s or simulator %s\n", portName, simPortName);
+        return asynError;
+    }
+    if (!pC->isManualPolling()) {
+        epicsStdoutPrintf("OWISPSBenchmark: controller %s not manually polled, see OWISPSConfigManualPolling\n", portName);
+        return asynError;
+    }
+    if (pC->findParam("MOTOR_STATUS_DONE", &done_param) != asynSuccess) {
+        return asynError;
+    }
+    while (pC->getAxis(num_axes)) {
+        num_axes++;
+    }
+
+    epicsStdoutPrintf("OWISPSBenchmark: controller %s, %d axes, simulator %s\n", portName, num_axes, simPortName);
+    pSim->report(stdout, 0);
+    pC->pollOnce(); // Axes discovery
+
+    benchPollCycle(pC, pSim, num_axes, done_param, poll_period, cycles);
+    benchMoves(pC, pSim, num_axes, done_param, poll_period);
+    benchDoneLatency(pC, simPortName, num_axes, done_param, poll_period);
+    benchReplyParse();
+
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSBenchmarkArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSBenchmarkArg1 = { "Simulator port name", iocshArgString };
+static const iocshArg OWISPSBenchmarkArg2 = { "Moving poll period (ms)", iocshArgInt };
+static const iocshArg OWISPSBenchmarkArg3 = { "Cycles", iocshArgInt };
+static const iocshArg * const OWISPSBenchmarkArgs[] = { &OWISPSBenchmarkArg0,
+                                                        &OWISPSBenchmarkArg1,
+                                                        &OWISPSBenchmarkArg2,
+                                                        &OWISPSBenchmarkArg3 };
+static const iocshFuncDef OWISPSBenchmarkDef = { "OWISPSBenchmark", 4, OWISPSBenchmarkArgs };
+static void OWISPSBenchmarkCallFunc(const iocshArgBuf *args) {
+    OWISPSBenchmark(args[0].sval, args[1].sval, args[2].ival, args[3].ival);
+}
+
+static void OWISPSBenchRegister(void) {
+    iocshRegister(&OWISPSBenchmarkDef, OWISPSBenchmarkCallFunc);
+}
+
+extern "C" {
+    epicsExportRegistrar(OWISPSBenchRegister);
+}
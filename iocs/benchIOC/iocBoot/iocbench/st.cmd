@@ -0,0 +1,24 @@
+#!../../bin/linux-x86_64/bench
+
+< envPaths
+
+## Register all support components
+dbLoadDatabase("../../dbd/bench.dbd",0,0)
+bench_registerRecordDeviceDriver(pdbbase) 
+
+# OWISPSCreateSimulator(portName, numAxes, baudRate, turnaroundTime)
+OWISPSCreateSimulator("SIM9600", 9, 9600, 2000)
+OWISPSCreateSimulator("SIM115200", 9, 115200, 2000)
+
+# No poller: poll cycles are run by the benchmarks themselves
+OWISPSConfigManualPolling(1)
+OWISPSCreateController("BENCH9600", "SIM9600", 9, 10000, 10000)
+OWISPSCreateController("BENCH115200", "SIM115200", 9, 10000, 10000)
+
+iocInit()
+
+# OWISPSBenchmark(portName, simPortName, movingPollPeriod, cycles)
+OWISPSBenchmark("BENCH9600", "SIM9600", 50, 100)
+OWISPSBenchmark("BENCH115200", "SIM115200", 50, 100)
+
+exit
@@ -10,71 +10,235 @@
 
 TEST(CommandBuild, AxisMove) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildMoveCommand(buffer, 0, 1250);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_POSSET, 0, 1250);
     ASSERT_STREQ("PSET1=1250", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisMoveStart) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildGenericCommand(buffer, OWISPS_POSGO_CMD, 1);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_POSGO, 1);
     ASSERT_STREQ("PGO2", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisMoveAbsoluteMode) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildGenericCommand(buffer, OWISPS_ABSCOORD_CMD, 0);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_ABSCOORD, 0);
     ASSERT_STREQ("ABSOL1", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisMoveRelativeMode) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildGenericCommand(buffer, OWISPS_RELCOORD_CMD, 1);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_RELCOORD, 1);
     ASSERT_STREQ("RELAT2", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisLimitSwitches) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildGenericCommand(buffer, OWISPS_LIMSTAT_CMD, 0);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_LIMSTAT, 0);
     ASSERT_STREQ("?ESTAT1", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisReadback) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildGenericCommand(buffer, OWISPS_GETCOUNTER_CMD, 1);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_GETCOUNTER, 1);
     ASSERT_STREQ("?CNT2", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisSetPosition) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildSetPositionCommand(buffer, 1, -6500);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_SETCOUNTER, 1, -6500);
     ASSERT_STREQ("CNT2=-6500", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisHome1) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildHomeCommand(buffer, 0, OWISPS_REF_REFSW0);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_HOME, 0, OWISPS_REF_REFSW0);
     ASSERT_STREQ("REF1=4", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisHome2) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildHomeCommand(buffer, 1, OWISPS_REF_IDX);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_HOME, 1, OWISPS_REF_IDX);
     ASSERT_STREQ("REF2=0", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
+}
+
+TEST(CommandBuild, AxisVelocity) {
+    char buffer[STRING_BUFFER_SIZE];
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_SETPOSVEL, 0, 20000);
+    ASSERT_STREQ("PVEL1=20000", buffer);
+    ASSERT_EQ(strlen(buffer), length);
+}
+
+TEST(CommandBuild, AxisAcceleration) {
+    char buffer[STRING_BUFFER_SIZE];
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_SETACC, 2, 50000);
+    ASSERT_STREQ("ACC3=50000", buffer);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
 TEST(CommandBuild, AxisStop) {
     char buffer[STRING_BUFFER_SIZE];
-    bool res = OWISPSAxis::buildGenericCommand(buffer, OWISPS_STOP_CMD, 1);
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_STOP, 1);
     ASSERT_STREQ("STOP2", buffer);
-    ASSERT_EQ(true, res);
+    ASSERT_EQ(strlen(buffer), length);
 }
 
+
+TEST(CommandBuild, BatchAppend) {
+    char buffer[STRING_BUFFER_SIZE] = "";
+    size_t length = OWISPSController::appendCommand(buffer, sizeof(buffer), 0, OWISPS_CMD_AXESSTAT, 0);
+    length = OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_LIMSTAT, 0);
+    length = OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_GETCOUNTER, 0);
+    ASSERT_STREQ("?ASTAT\r?ESTAT1\r?CNT1", buffer);
+    ASSERT_EQ((size_t)20, length);
+}
+
+TEST(CommandBuild, BatchOverflow) {
+    char buffer[12] = "?ESTAT1";
+    size_t length = OWISPSController::appendCommand(buffer, sizeof(buffer), strlen(buffer), OWISPS_CMD_GETCOUNTER, 0);
+    ASSERT_STREQ("?ESTAT1", buffer);
+    ASSERT_EQ((size_t)0, length);
+}
+
+TEST(CommandBuild, TraceEntry) {
+    char buffer[2*MAX_OWISPS_STRING_SIZE];
+    owispsTraceEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.kind = OWISPS_TRACE_WRITE;
+    entry.duration = 1250;
+    entry.status = asynSuccess;
+    entry.length = 10;
+    memcpy(entry.text, "PSET1=5\rPGO1", 10);
+    OWISPSController::formatTraceEntry(&entry, buffer, sizeof(buffer));
+    ASSERT_TRUE(strstr(buffer, " W     1250us ok    PSET1=5|PG") != NULL);
+}
+
+TEST(CommandBuild, TraceEntryTruncated) {
+    char buffer[2*MAX_OWISPS_STRING_SIZE];
+    owispsTraceEntry entry;
+    memset(&entry, 'X', sizeof(entry));
+    entry.kind = OWISPS_TRACE_REPLY;
+    entry.duration = 0;
+    entry.status = asynTimeout;
+    entry.length = OWISPS_TRACE_TEXT_SIZE+1;
+    OWISPSController::formatTraceEntry(&entry, buffer, sizeof(buffer));
+    ASSERT_TRUE(strstr(buffer, " R        0us tmo   XXX") != NULL);
+    ASSERT_TRUE(strstr(buffer, "X...") != NULL);
+}
+
+TEST(CommandBuild, TranscriptLine) {
+    char buffer[MAX_OWISPS_SEQUENCE_SIZE+MAX_OWISPS_STRING_SIZE];
+    owispsTranscriptEntry entry, parsed;
+    entry.offset = 12.5;
+    entry.duration = 0.00125;
+    entry.kind = OWISPS_TRACE_WRITE;
+    entry.status = asynSuccess;
+    strcpy(entry.text, "PSET1=5\rPGO1");
+    OWISPSController::formatTranscriptLine(&entry, buffer, sizeof(buffer));
+    ASSERT_STREQ("12.500000 W 0.001250 0 PSET1=5|PGO1\n", buffer);
+    ASSERT_EQ(true, OWISPSController::parseTranscriptLine(buffer, parsed));
+    ASSERT_DOUBLE_EQ(12.5, parsed.offset);
+    ASSERT_DOUBLE_EQ(0.00125, parsed.duration);
+    ASSERT_EQ(OWISPS_TRACE_WRITE, parsed.kind);
+    ASSERT_EQ(asynSuccess, parsed.status);
+    ASSERT_STREQ("PSET1=5\rPGO1", parsed.text);
+}
+
+TEST(CommandBuild, TranscriptLineEmptyText) {
+    owispsTranscriptEntry parsed;
+    ASSERT_EQ(true, OWISPSController::parseTranscriptLine("0.100000 C 0.000000 0 \n", parsed));
+    ASSERT_EQ(OWISPS_TRACE_CYCLE, parsed.kind);
+    ASSERT_STREQ("", parsed.text);
+    ASSERT_EQ(true, OWISPSController::parseTranscriptLine("0.200000 R 0.000000 1", parsed));
+    ASSERT_EQ(asynTimeout, parsed.status);
+    ASSERT_STREQ("", parsed.text);
+}
+
+TEST(CommandBuild, TranscriptLineInvalid) {
+    owispsTranscriptEntry parsed;
+    ASSERT_EQ(false, OWISPSController::parseTranscriptLine(OWISPS_TRANSCRIPT_HEADER " ctrl 2\n", parsed));
+    ASSERT_EQ(false, OWISPSController::parseTranscriptLine("garbage\n", parsed));
+}
+
+TEST(CommandBuild, MoveSequence) {
+    char buffer[MAX_OWISPS_SEQUENCE_SIZE] = "";
+    size_t length = OWISPSController::appendCommand(buffer, sizeof(buffer), 0, OWISPS_CMD_MON, 0);
+    length = OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_ABSCOORD, 0);
+    length = OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_POSSET, 0, -300);
+    length = OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_POSGO, 0);
+    ASSERT_STREQ("MON1\rABSOL1\rPSET1=-300\rPGO1", buffer);
+    ASSERT_EQ(strlen(buffer), length);
+}
+
+TEST(CommandBuild, CommandTableLength) {
+    char buffer[STRING_BUFFER_SIZE];
+    size_t length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_POSSET, 0, -300);
+    ASSERT_STREQ("PSET1=-300", buffer);
+    ASSERT_EQ((size_t)10, length);
+    length = OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_AXESSTAT, 3);
+    ASSERT_STREQ("?ASTAT", buffer);
+    ASSERT_EQ((size_t)6, length);
+}
+
+TEST(CommandBuild, CommandTableOverflow) {
+    char buffer[5] = "xyz";
+    ASSERT_EQ((size_t)0, OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_SETCOUNTER, 1, -6500));
+    ASSERT_STREQ("xyz", buffer);
+    ASSERT_EQ((size_t)4, OWISPSController::formatCommand(buffer, sizeof(buffer), OWISPS_CMD_POSGO, 0));
+    ASSERT_STREQ("PGO1", buffer);
+}
+
+TEST(CommandBuild, CommandTableBatch) {
+    char buffer[16] = "";
+    size_t length = OWISPSController::appendCommand(buffer, sizeof(buffer), 0, OWISPS_CMD_AXESSTAT, 0);
+    length = OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_LIMSTAT, 0);
+    ASSERT_STREQ("?ASTAT\r?ESTAT1", buffer);
+    ASSERT_EQ((size_t)14, length);
+    ASSERT_EQ((size_t)0, OWISPSController::appendCommand(buffer, sizeof(buffer), length, OWISPS_CMD_GETCOUNTER, 0));
+    ASSERT_STREQ("?ASTAT\r?ESTAT1", buffer);
+}
+
+TEST(CommandBuild, CommandTableReplies) {
+    ASSERT_EQ(OWISPS_REPLY_STATUS, OWISPSController::commandDescriptor(OWISPS_CMD_AXESSTAT)->reply);
+    ASSERT_EQ(OWISPS_REPLY_NONE, OWISPSController::commandDescriptor(OWISPS_CMD_POSGO)->reply);
+    ASSERT_EQ(true, OWISPSController::isReplyValid(OWISPS_REPLY_INTEGER, "-1250", 5));
+    ASSERT_EQ(false, OWISPSController::isReplyValid(OWISPS_REPLY_INTEGER, "12a", 3));
+    ASSERT_EQ(false, OWISPSController::isReplyValid(OWISPS_REPLY_STATUS, "", 0));
+    ASSERT_EQ(true, OWISPSController::isReplyValid(OWISPS_REPLY_TEXT, "", 0));
+}
+
+TEST(CommandBuild, CacheLine) {
+    char buffer[STRING_BUFFER_SIZE];
+    owispsCacheEntry entry = { 2, STEPPER_OPENLOOP, OWISPS_REF_REFSW0, 20000, -1250, 1 }, parsed;
+    OWISPSController::formatCacheLine(&entry, buffer, sizeof(buffer));
+    ASSERT_STREQ("axis 2 2 4 20000 -1250 1\n", buffer);
+    ASSERT_EQ(true, OWISPSController::parseCacheLine(buffer, parsed));
+    ASSERT_EQ(2, parsed.axis);
+    ASSERT_EQ(STEPPER_OPENLOOP, parsed.type);
+    ASSERT_EQ(OWISPS_REF_REFSW0, parsed.homingType);
+    ASSERT_EQ(20000, parsed.velocity);
+    ASSERT_EQ(-1250, parsed.counter);
+    ASSERT_EQ(1, parsed.homed);
+    ASSERT_EQ(true, OWISPSController::parseCacheLine("axis 0 2 4 100\n", parsed));
+    ASSERT_EQ(0, parsed.counter);
+    ASSERT_EQ(-1, parsed.homed);
+}
+
+TEST(CommandBuild, CacheLineInvalid) {
+    owispsCacheEntry parsed = { 1, DC_BRUSH, 0, 0, 0, -1 };
+    ASSERT_EQ(false, OWISPSController::parseCacheLine(OWISPS_CACHE_HEADER " ctrl 2\n", parsed));
+    ASSERT_EQ(false, OWISPSController::parseCacheLine("version PS10 1.0\n", parsed));
+    ASSERT_EQ(false, OWISPSController::parseCacheLine("axis 0 7 4 100\n", parsed));
+    ASSERT_EQ(false, OWISPSController::parseCacheLine("axis 0 2 4\n", parsed));
+    ASSERT_EQ(false, OWISPSController::parseCacheLine("axis 0 2 4 100 50 2\n", parsed));
+    ASSERT_EQ(1, parsed.axis);
+}
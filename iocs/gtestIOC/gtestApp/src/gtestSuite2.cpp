@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <epicsThread.h>
 
 #include "OWISPSMotorDriver.h"
+#include "OWISPSSimulator.h"
+#include "OWISPSReplay.h"
 
 
 
@@ -84,6 +89,282 @@ TEST(ReplyParse, ErrorStepperOpen) {
 }
 
 
+TEST(ReplyParse, MovingStatus) {
+    ASSERT_EQ(true, OWISPSAxis::isMovingStatus(OWISPS_STATUS_POSTRAP));
+    ASSERT_EQ(true, OWISPSAxis::isMovingStatus(OWISPS_STATUS_HOMING));
+    ASSERT_EQ(true, OWISPSAxis::isMovingStatus(OWISPS_STATUS_POSSCURVWMS));
+}
+
+TEST(ReplyParse, IdleStatus) {
+    ASSERT_EQ(false, OWISPSAxis::isMovingStatus(OWISPS_STATUS_READY));
+    ASSERT_EQ(false, OWISPSAxis::isMovingStatus(OWISPS_STATUS_DISABLED));
+    ASSERT_EQ(false, OWISPSAxis::isMovingStatus(OWISPS_STATUS_UNKNOWN));
+}
+
+
+TEST(ReplyParse, PositionVelocity) {
+    char reply[] = "5000";
+    int vel;
+    asynStatus asyn_error = asynSuccess;
+    bool res = OWISPSAxis::updateAxisVelocity(asynSuccess, reply, vel, &asyn_error);
+    ASSERT_EQ(true, res);
+    ASSERT_EQ(5000, vel);
+    ASSERT_EQ(asynSuccess, asyn_error);
+}
+
+TEST(ReplyParse, ErrorPositionVelocity) {
+    char reply[] = "-";
+    int vel;
+    asynStatus asyn_error = asynSuccess;
+    bool res = OWISPSAxis::updateAxisVelocity(asynSuccess, reply, vel, &asyn_error);
+    ASSERT_EQ(false, res);
+    ASSERT_EQ(asynError, asyn_error);
+}
+
+TEST(ReplyParse, IntegerLength) {
+    long value = 0;
+    ASSERT_EQ(5u, OWISPSAxis::parseInteger("-2500\r1000", MAX_OWISPS_STRING_SIZE, value));
+    ASSERT_EQ(-2500, value);
+    ASSERT_EQ(2u, OWISPSAxis::parseInteger("1234", 2, value));
+    ASSERT_EQ(12, value);
+}
+
+TEST(ReplyParse, IntegerInvalid) {
+    long value = 7;
+    ASSERT_EQ(0u, OWISPSAxis::parseInteger("", MAX_OWISPS_STRING_SIZE, value));
+    ASSERT_EQ(0u, OWISPSAxis::parseInteger("-", MAX_OWISPS_STRING_SIZE, value));
+    ASSERT_EQ(0u, OWISPSAxis::parseInteger("99999999999999999999", MAX_OWISPS_STRING_SIZE, value));
+    ASSERT_EQ(0u, OWISPSAxis::parseInteger(NULL, MAX_OWISPS_STRING_SIZE, value));
+    ASSERT_EQ(7, value);
+}
+
+TEST(ReplyParse, StatusFlags) {
+    ASSERT_EQ(OWISPS_STATUSFLAG_DONE, OWISPSAxis::statusFlags(OWISPS_STATUS_READY));
+    ASSERT_EQ(OWISPS_STATUSFLAG_MOVING, OWISPSAxis::statusFlags(OWISPS_STATUS_POSTRAP));
+    ASSERT_EQ(OWISPS_STATUSFLAG_MOVING | OWISPS_STATUSFLAG_HOMING, OWISPSAxis::statusFlags(OWISPS_STATUS_HOMING));
+    ASSERT_EQ(OWISPS_STATUSFLAG_PROBLEM, OWISPSAxis::statusFlags(OWISPS_STATUS_UNKNOWN));
+    ASSERT_EQ(0, OWISPSAxis::statusFlags(OWISPS_STATUS_DISABLED));
+    ASSERT_EQ(0, OWISPSAxis::statusFlags((char)0xff));
+}
+
+TEST(ReplyParse, IntegerMatchesAtol) {
+    const char *replies[] = { "0", "-2500", "1000000", "-123456789" };
+    long value;
+    for (int i=0; i<4; i++) {
+        ASSERT_EQ(true, OWISPSAxis::updateAxisReadbackPosition(asynSuccess, replies[i], value, NULL));
+        ASSERT_EQ(atol(replies[i]), value);
+    }
+}
+
+TEST(ReplyParse, StatusMovingCount) {
+    const char astat[] = "RTSPIO?WXRRTT";
+    int moving = 0;
+    for (int i=0; i<13; i++) {
+        moving += (OWISPSAxis::statusFlags(astat[i]) & OWISPS_STATUSFLAG_MOVING) ? 1 : 0;
+    }
+    ASSERT_EQ(7, moving);
+}
+
+
+
+TEST(MotionPredict, UnknownVelocity) {
+    ASSERT_DOUBLE_EQ(-1, OWISPSAxis::estimateMoveTime(1000, 0, 100));
+}
+
+TEST(MotionPredict, NoAcceleration) {
+    ASSERT_DOUBLE_EQ(2, OWISPSAxis::estimateMoveTime(-2000, 1000, 0));
+}
+
+TEST(MotionPredict, Trapezoidal) {
+    // Two 1s ramps over 500 steps each, 9000 steps at cruise velocity
+    ASSERT_DOUBLE_EQ(11, OWISPSAxis::estimateMoveTime(10000, 1000, 1000));
+}
+
+TEST(MotionPredict, Triangular) {
+    ASSERT_DOUBLE_EQ(2, OWISPSAxis::estimateMoveTime(400, 1000, 400));
+}
+
+TEST(CaptureRing, NotWrapped) {
+    ASSERT_EQ(0, OWISPSAxis::captureRingIndex(3, 3, 10, 0));
+    ASSERT_EQ(2, OWISPSAxis::captureRingIndex(3, 3, 10, 2));
+}
+
+TEST(CaptureRing, Wrapped) {
+    // Full buffer, next slot 4: oldest sample in slot 4, newest in slot 3
+    ASSERT_EQ(4, OWISPSAxis::captureRingIndex(4, 10, 10, 0));
+    ASSERT_EQ(0, OWISPSAxis::captureRingIndex(4, 10, 10, 6));
+    ASSERT_EQ(3, OWISPSAxis::captureRingIndex(4, 10, 10, 9));
+}
+
+TEST(Simulator, Accelerating) {
+    double traveled;
+    ASSERT_EQ(false, OWISPSSimulator::profilePosition(10000, 1000, 1000, 0.5, traveled));
+    ASSERT_DOUBLE_EQ(125, traveled);
+}
+
+TEST(Simulator, Cruising) {
+    double traveled;
+    // 500 steps of ramp, then 4s at cruise velocity
+    ASSERT_EQ(false, OWISPSSimulator::profilePosition(10000, 1000, 1000, 5, traveled));
+    ASSERT_DOUBLE_EQ(4500, traveled);
+}
+
+TEST(Simulator, Decelerating) {
+    double traveled;
+    ASSERT_EQ(false, OWISPSSimulator::profilePosition(-10000, 1000, 1000, 10.5, traveled));
+    ASSERT_DOUBLE_EQ(9875, traveled);
+}
+
+TEST(Simulator, Done) {
+    double traveled;
+    ASSERT_EQ(true, OWISPSSimulator::profilePosition(400, 1000, 400, 2, traveled));
+    ASSERT_DOUBLE_EQ(400, traveled);
+}
+
+TEST(LinkStats, ClassifyCommand) {
+    ASSERT_EQ(OWISPS_CMDTYPE_ASTAT, OWISPSController::classifyCommand("?ASTAT"));
+    ASSERT_EQ(OWISPS_CMDTYPE_CNT, OWISPSController::classifyCommand("?CNT3"));
+    ASSERT_EQ(OWISPS_CMDTYPE_STOP, OWISPSController::classifyCommand("STOP1"));
+    ASSERT_EQ(OWISPS_CMDTYPE_OTHER, OWISPSController::classifyCommand("?PVEL1"));
+}
+
+TEST(LinkStats, ClassifySequence) {
+    ASSERT_EQ(OWISPS_CMDTYPE_MOVE, OWISPSController::classifyCommand("MON1\rABSOL1\rPSET1=100\rPGO1"));
+    ASSERT_EQ(OWISPS_CMDTYPE_HOME, OWISPSController::classifyCommand("ACC1=500\rREF1=4\r"));
+}
+
+TEST(LinkStats, LatencyBucket) {
+    ASSERT_EQ(0, OWISPSController::latencyBucket(0));
+    ASSERT_EQ(0, OWISPSController::latencyBucket(1));
+    ASSERT_EQ(10, OWISPSController::latencyBucket(1500));
+    ASSERT_EQ(OWISPS_LATENCY_BUCKETS-1, OWISPSController::latencyBucket(2000000000));
+}
+
+TEST(LinkStats, LatencyPercentile) {
+    size_t buckets[OWISPS_LATENCY_BUCKETS] = {0};
+    buckets[10] = 99;
+    buckets[12] = 1;
+    ASSERT_DOUBLE_EQ(2048, OWISPSController::latencyPercentile(buckets, 100, 0.99));
+    ASSERT_DOUBLE_EQ(8192, OWISPSController::latencyPercentile(buckets, 100, 1));
+    ASSERT_DOUBLE_EQ(0, OWISPSController::latencyPercentile(buckets, 0, 0.99));
+}
+
+TEST(LinkStats, ProbeBackoff) {
+    ASSERT_DOUBLE_EQ(OWISPS_PROBE_MIN_PERIOD, OWISPSController::nextProbeBackoff(0));
+    ASSERT_DOUBLE_EQ(2*OWISPS_PROBE_MIN_PERIOD, OWISPSController::nextProbeBackoff(OWISPS_PROBE_MIN_PERIOD));
+    ASSERT_DOUBLE_EQ(OWISPS_PROBE_MAX_PERIOD, OWISPSController::nextProbeBackoff(OWISPS_PROBE_MAX_PERIOD*0.75));
+    ASSERT_DOUBLE_EQ(OWISPS_PROBE_MAX_PERIOD, OWISPSController::nextProbeBackoff(OWISPS_PROBE_MAX_PERIOD));
+}
+
+/** Runs one poll cycle, and gives the number of batches it wrote to the simulator.
+  *
+  */
+static int pollCycleWrites(OWISPSController *ctrl, OWISPSSimulator *sim) {
+    int writes, reads;
+    long bytes;
+
+    sim->lock();
+    sim->resetStatistics();
+    sim->unlock();
+    ctrl->pollOnce();
+    sim->lock();
+    sim->getStatistics(writes, reads, bytes);
+    sim->unlock();
+    return writes;
+}
+
+static int commsError(OWISPSController *ctrl, int axis) {
+    int param, value = -1;
+
+    ctrl->findParam("MOTOR_STATUS_COMMS_ERROR", &param);
+    ctrl->getIntegerParam(axis, param, &value);
+    return value;
+}
+
+static void setAnswering(OWISPSSimulator *sim, bool answering) {
+    sim->lock();
+    sim->setAnswering(answering);
+    sim->unlock();
+}
+
+/** Transactions per poll cycle before, during and after an outage of the controller.
+  * Takes two controller timeouts.
+  */
+TEST(Outage, PollCycleWrites) {
+    OWISPSSimulator *sim = new OWISPSSimulator("outage_sim", 2, 0, 0);
+    OWISPSController::setManualPolling(true);
+    OWISPSController *ctrl = new OWISPSController("outage_ctrl", "outage_sim", 2, 0.1, 0.1);
+    OWISPSController::setManualPolling(false);
+    ctrl->setForcedRefreshPeriod(1000); // Idle axes only queried when their status changes
+
+    // Discovery, then the queries of the axes just discovered
+    EXPECT_EQ(2, pollCycleWrites(ctrl, sim));
+    EXPECT_EQ(0, commsError(ctrl, 0));
+    EXPECT_EQ(0, commsError(ctrl, 1));
+
+    // ?ASTAT unchanged: no axis queried; changed: only that axis queried
+    EXPECT_EQ(1, pollCycleWrites(ctrl, sim));
+    ctrl->writePriorityController("MOFF1");
+    EXPECT_EQ(2, pollCycleWrites(ctrl, sim));
+    EXPECT_EQ(1, pollCycleWrites(ctrl, sim));
+
+    // A single timeout takes the controller offline, it is then only probed with ?ASTAT
+    setAnswering(sim, false);
+    EXPECT_EQ(1, pollCycleWrites(ctrl, sim));
+    EXPECT_EQ(1, commsError(ctrl, 0));
+    EXPECT_EQ(1, commsError(ctrl, 1));
+    EXPECT_EQ(0, pollCycleWrites(ctrl, sim));
+    epicsThreadSleep(OWISPS_PROBE_MIN_PERIOD + 0.1);
+    EXPECT_EQ(1, pollCycleWrites(ctrl, sim));
+    EXPECT_EQ(0, pollCycleWrites(ctrl, sim)); // Backoff doubled
+
+    // Answering again: the probe succeeds, then the axes are discovered again
+    setAnswering(sim, true);
+    epicsThreadSleep(2*OWISPS_PROBE_MIN_PERIOD + 0.1);
+    EXPECT_EQ(1, pollCycleWrites(ctrl, sim));
+    EXPECT_EQ(1, commsError(ctrl, 0));
+    EXPECT_EQ(2, pollCycleWrites(ctrl, sim));
+    EXPECT_EQ(0, commsError(ctrl, 0));
+    EXPECT_EQ(0, commsError(ctrl, 1));
+    EXPECT_EQ(1, pollCycleWrites(ctrl, sim));
+
+    delete ctrl;
+    delete sim;
+}
+
+TEST(Replay, IsQuery) {
+    ASSERT_EQ(true, OWISPSReplay::isQuery("?ASTAT"));
+    ASSERT_EQ(true, OWISPSReplay::isQuery("?CNT1"));
+    ASSERT_EQ(false, OWISPSReplay::isQuery("PSET1=100"));
+}
+
+/** Regression test against a recorded transcript, see OWISPSRecordStart.
+  * Only run when OWISPS_REPLAY_TRANSCRIPT names a transcript, replayed in real time.
+  */
+TEST(Replay, Transcript) {
+    const char *file_name = getenv("OWISPS_REPLAY_TRANSCRIPT");
+    if (!file_name) {
+        GTEST_SKIP() << "OWISPS_REPLAY_TRANSCRIPT not set";
+    }
+
+    OWISPSReplay *replay = new OWISPSReplay("replay_conn", file_name, 1);
+    if (replay->getRecordedAxes() <= 0) {
+        delete replay;
+        FAIL() << "cannot load " << file_name;
+    }
+
+    // No poller: the replay runs every poll cycle, discovery included
+    OWISPSController::setManualPolling(true);
+    OWISPSController *ctrl = new OWISPSController("replay_ctrl", "replay_conn", replay->getRecordedAxes(), 1000, 1000);
+    OWISPSController::setManualPolling(false);
+    bool replayed = replay->run(ctrl, stdout);
+
+    delete ctrl;
+    delete replay;
+    ASSERT_EQ(true, replayed);
+}
+
+
 /*
 
 TEST(ReplyParse, MotorPowerOff) {
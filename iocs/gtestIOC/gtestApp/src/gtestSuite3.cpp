@@ -49,3 +49,78 @@ TEST(updateAxisStatusMock, MovingFromStopped) {
     dummy_axis.updateAxisStatus(OWISPS_STATUS_HOMING);
 }
 
+
+
+
+class CallbacksOWISPSAxis: public OWISPSAxis {
+public:
+    CallbacksOWISPSAxis(OWISPSController *ctrl): OWISPSAxis(ctrl, 0) {
+        this->pC_->shuttingDown_ = 1;
+    }
+
+    void log(int reason, const char *format, ...) {}
+
+    MOCK_METHOD(asynStatus, callParamCallbacks, (), (override));
+
+    void updateStopLatency(double latency) {
+        OWISPSAxis::updateStopLatency(latency);
+    }
+
+    asynStatus flushParams(void) {
+        return OWISPSAxis::flushParams();
+    }
+};
+
+class CruiseOWISPSAxis: public OWISPSAxis {
+public:
+    CruiseOWISPSAxis(OWISPSController *ctrl): OWISPSAxis(ctrl, 1) {
+        this->pC_->shuttingDown_ = 1;
+        this->positionVelocity = 1000;
+    }
+
+    void log(int reason, const char *format, ...) {}
+
+    MOCK_METHOD(asynStatus, callParamCallbacks, (), (override));
+
+    // A 100 s move, last refreshed in the future so that only the prediction can make it due
+    void startCruise(const epicsTimeStamp *later) {
+        this->axisType = STEPPER_OPENLOOP;
+        updateAxisStatus(OWISPS_STATUS_POSTRAP);
+        queuePollCommands(later);
+        clearPollCommands();
+        predictMotionDone(100000, 0);
+    }
+
+    asynStatus stopUnconnected(void) {
+        this->axisType = UNKNOWN; // Nothing written to the fake controller
+        asynStatus status = stop(0);
+        this->axisType = STEPPER_OPENLOOP;
+        return status;
+    }
+
+    bool isPollDue(const epicsTimeStamp *now) {
+        return OWISPSAxis::isPollDue(now);
+    }
+};
+
+TEST(isPollDueMock, StopDuringCruise) {
+    CruiseOWISPSAxis dummy_axis(&dummy_ctrl);
+    epicsTimeStamp now, later;
+    epicsTimeGetCurrent(&now);
+    later = now;
+    epicsTimeAddSeconds(&later, 10);
+    dummy_axis.startCruise(&later);
+    ASSERT_EQ(false, dummy_axis.isPollDue(&now));
+    dummy_axis.stopUnconnected();
+    ASSERT_EQ(true, dummy_axis.isPollDue(&now));
+}
+
+TEST(flushParamsMock, OncePerChange) {
+    CallbacksOWISPSAxis dummy_axis(&dummy_ctrl);
+    EXPECT_CALL(dummy_axis, callParamCallbacks()).Times(1);
+    dummy_axis.updateStopLatency(0.010);
+    dummy_axis.updateStopLatency(0.020);
+    dummy_axis.flushParams();
+    dummy_axis.updateStopLatency(0.020);
+    dummy_axis.flushParams();
+}
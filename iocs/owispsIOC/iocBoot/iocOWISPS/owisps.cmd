@@ -13,6 +13,9 @@ asynSetOption ("SERUSB0", 0, "stop",    "1")
 asynSetOption ("SERUSB0", 0, "clocal",  "Y")  # Y = ignore DTR/DSR
 asynSetOption ("SERUSB0", 0, "crtscts", "N")  # N = ignore RTS/CTS
 
+# Or simulate a PS (no asynSetOption needed): OWISPSCreateSimulator(portName, numAxes, baudRate, turnaroundTime)
+#OWISPSCreateSimulator("SERUSB0", 3, 9600, 2000)
+
 # Load asyn record
 dbLoadRecords("$(ASYN)/db/asynRecord.db", "P=OWISPS:, R=ASYN1, PORT=SERUSB0, ADDR=0, OMAX=256, IMAX=256")
 
@@ -20,9 +23,27 @@ dbLoadRecords("$(ASYN)/db/asynRecord.db", "P=OWISPS:, R=ASYN1, PORT=SERUSB0, ADD
 asynSetTraceMask("SERUSB0", 0, 0x03)
 asynSetTraceIOMask("SERUSB0", 0, 0x04)
 
+# Restore the axes configuration at startup, verified in the background: OWISPSConfigCache(directory, restoreHomed) before creating the controllers
+#OWISPSConfigCache("${TOP}/iocBoot/${IOC}", 1)
+
+# Many controllers: share a few poller threads between them, OWISPSCreatePollers(numThreads) before creating them
+#OWISPSCreatePollers(2)
+
 # OWISPSCreateController(portName, asynPort, numAxes, movingPollingRate, idlePollingRate)
 OWISPSCreateController("OWISPS35", "SERUSB0", 3, 50, 200)
 
+# OWISPSConfigRefresh(portName, forcedRefreshPeriod)
+#OWISPSConfigRefresh("OWISPS35", 1000)
+
+# OWISPSCreateProfile(portName, maxPoints)
+#OWISPSCreateProfile("OWISPS35", 2000)
+
+# Serial traffic is always traced in memory, dump it with OWISPSTraceDump(portName, count, fileName)
+#OWISPSTraceDump("OWISPS35", 100, "")
+
+# Record a transcript of the serial traffic, for OWISPSCreateReplay: OWISPSRecordStart(portName, fileName), OWISPSRecordStop(portName)
+#OWISPSRecordStart("OWISPS35", "/tmp/owisps35.transcript")
+
 # Turn off asyn trace
 asynSetTraceMask("SERUSB0", 0, 0x01)
 asynSetTraceIOMask("SERUSB0", 0, 0x00)
@@ -11,13 +11,18 @@ September 2020
 #include <stdlib.h>
 #include <math.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include "OWISPSMotorDriver.h"
+#include "OWISPSPoller.h"
 
 #include <iocsh.h>
 #include <epicsThread.h>
+#include <epicsAtomic.h>
+#include <epicsExit.h>
 
 #include <asynOctetSyncIO.h>
+#include <asynPortDriver.h>
 
 #include <epicsExport.h>
 
@@ -25,6 +30,87 @@ September 2020
 
 static const char *driverName = "OWISPSController";
 
+static const char *commandTypeNames[OWISPS_NUM_CMDTYPES] = { "ASTAT", "ESTAT", "CNT", "MOVE", "HOME", "STOP", "OTHER" };
+
+static char cacheDirectory[MAX_OWISPS_PATH_SIZE] = ""; // Set by OWISPSConfigCache, empty if no cache
+static bool restoreHomedFlags = false;                // Set by OWISPSConfigCache
+static bool manualPollingFlag = false;                // Set by OWISPSConfigManualPolling
+
+#define OWISPS_COMMAND(name, args, reply, type) { name, sizeof(name)-1, args, reply, type }
+
+/** Every command sent by the driver, indexed by owispsCommandId.
+  *
+  */
+static constexpr owispsCommandDescriptor commandTable[] = {
+    OWISPS_COMMAND("?MOTYPE",  OWISPS_ARGS_AXIS,       OWISPS_REPLY_INTEGER, OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("?ASTAT",   OWISPS_ARGS_NONE,       OWISPS_REPLY_STATUS,  OWISPS_CMDTYPE_ASTAT),
+    OWISPS_COMMAND("?ESTAT",   OWISPS_ARGS_AXIS,       OWISPS_REPLY_INTEGER, OWISPS_CMDTYPE_ESTAT),
+    OWISPS_COMMAND("INIT",     OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("MOFF",     OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("MON",      OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("STOP",     OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_STOP),
+    OWISPS_COMMAND("?CNT",     OWISPS_ARGS_AXIS,       OWISPS_REPLY_INTEGER, OWISPS_CMDTYPE_CNT),
+    OWISPS_COMMAND("CNT",      OWISPS_ARGS_AXIS_VALUE, OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("?PVEL",    OWISPS_ARGS_AXIS,       OWISPS_REPLY_INTEGER, OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("PVEL",     OWISPS_ARGS_AXIS_VALUE, OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("?ACC",     OWISPS_ARGS_AXIS,       OWISPS_REPLY_INTEGER, OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("ACC",      OWISPS_ARGS_AXIS_VALUE, OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("ABSOL",    OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("RELAT",    OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("PSET",     OWISPS_ARGS_AXIS_VALUE, OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_MOVE),
+    OWISPS_COMMAND("?PSET",    OWISPS_ARGS_AXIS,       OWISPS_REPLY_INTEGER, OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("PGO",      OWISPS_ARGS_AXIS,       OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_MOVE),
+    OWISPS_COMMAND("REF",      OWISPS_ARGS_AXIS_VALUE, OWISPS_REPLY_NONE,    OWISPS_CMDTYPE_HOME),
+    OWISPS_COMMAND("?VERSION", OWISPS_ARGS_NONE,       OWISPS_REPLY_TEXT,    OWISPS_CMDTYPE_OTHER),
+    OWISPS_COMMAND("?MSG",     OWISPS_ARGS_NONE,       OWISPS_REPLY_TEXT,    OWISPS_CMDTYPE_OTHER)
+};
+
+static_assert(sizeof(commandTable)/sizeof(commandTable[0]) == OWISPS_NUM_CMDS, "commandTable out of step with owispsCommandId");
+static_assert(commandTable[OWISPS_CMD_POSSET].length == 4, "commandTable out of step with owispsCommandId");
+static_assert(commandTable[OWISPS_CMD_MSG].reply == OWISPS_REPLY_TEXT, "commandTable out of step with owispsCommandId");
+
+/** Status flags of a ?ASTAT character, see statusFlagTable.
+  *
+  */
+static constexpr epicsUInt8 statusFlagsOf(int owisps_status) {
+    return (owisps_status == OWISPS_STATUS_READY)   ? OWISPS_STATUSFLAG_DONE :
+           (owisps_status == OWISPS_STATUS_HOMING)  ? (OWISPS_STATUSFLAG_MOVING | OWISPS_STATUSFLAG_HOMING) :
+           (owisps_status == OWISPS_STATUS_UNKNOWN) ? OWISPS_STATUSFLAG_PROBLEM :
+           ((owisps_status == OWISPS_STATUS_POSTRAP)    ||
+            (owisps_status == OWISPS_STATUS_POSSCURVE)  ||
+            (owisps_status == OWISPS_STATUS_RELEASW)    ||
+            (owisps_status == OWISPS_STATUS_POSTRAPWMS) ||
+            (owisps_status == OWISPS_STATUS_POSSCURVWMS)  ) ? OWISPS_STATUSFLAG_MOVING : 0;
+}
+
+#define OWISPS_STATUSFLAGS4(c)  statusFlagsOf(c), statusFlagsOf(c+1), statusFlagsOf(c+2), statusFlagsOf(c+3)
+#define OWISPS_STATUSFLAGS16(c) OWISPS_STATUSFLAGS4(c), OWISPS_STATUSFLAGS4(c+4), OWISPS_STATUSFLAGS4(c+8), OWISPS_STATUSFLAGS4(c+12)
+#define OWISPS_STATUSFLAGS64(c) OWISPS_STATUSFLAGS16(c), OWISPS_STATUSFLAGS16(c+16), OWISPS_STATUSFLAGS16(c+32), OWISPS_STATUSFLAGS16(c+48)
+
+/** Status flags of every ?ASTAT character, built at compile time; characters without flags leave the axis status alone.
+  *
+  */
+static constexpr epicsUInt8 statusFlagTable[256] = { OWISPS_STATUSFLAGS64(0), OWISPS_STATUSFLAGS64(64), OWISPS_STATUSFLAGS64(128), OWISPS_STATUSFLAGS64(192) };
+
+static void OWISPSIoThreadC(void *pPvt) {
+    static_cast<OWISPSController*>(pPvt)->ioThread();
+}
+
+static void OWISPSProfileThreadC(void *pPvt) {
+    static_cast<OWISPSController*>(pPvt)->profileThread();
+}
+
+static void OWISPSFlushCacheC(void *pPvt) {
+    OWISPSController *pC = *static_cast<OWISPSController**>(pPvt);
+    if (pC) {
+        pC->syncCache();
+    }
+}
+
+static void OWISPSCacheThreadC(void *pPvt) {
+    static_cast<OWISPSController*>(pPvt)->cacheThread();
+}
+
 /** Creates a new OWISPSController object.
   *
   * \param[in] portName          The name of the asyn port that will be created for this driver
@@ -35,8 +121,8 @@ static const char *driverName = "OWISPSController";
   */
 OWISPSController::OWISPSController(const char *portName, const char *asynPortName, int numAxes, double movingPollPeriod, double idlePollPeriod)
     :asynMotorController(portName, numAxes, NUM_OWISPS_PARAMS, 
-                         asynOctetMask, 
-                         asynOctetMask,
+                         asynOctetMask | asynInt8ArrayMask, 
+                         asynOctetMask | asynInt8ArrayMask,
                          ASYN_CANBLOCK | ASYN_MULTIDEVICE, 
                          1, /* autoconnect */
                          0, 0) /* Default priority and stack size */ {
@@ -46,9 +132,91 @@ OWISPSController::OWISPSController(const char *portName, const char *asynPortNam
     int eos_len;
     static const char *functionName = "OWISPSController";
 
+    this->ioMutex = epicsMutexMustCreate();
+    this->ioStatusMutex = epicsMutexMustCreate();
+    this->ioQueue = NULL;
+    this->batchDoneEvent = epicsEventMustCreate(epicsEventEmpty);
+    this->ioExitEvent = epicsEventMustCreate(epicsEventEmpty);
+    this->movesDeferred = false;
+    this->profileExecuteEvent = NULL;
+    this->profilePointEvent = epicsEventMustCreate(epicsEventEmpty);
+    this->profileExecuting = false;
+    this->profileAbortRequested = false;
+    this->pasynUserPriority = NULL;
+    this->pasynOctetPriority = NULL;
+    this->octetPriorityPvt = NULL;
+    this->sharedPoller = NULL;
+    this->manualPolling = manualPollingFlag;
+    this->pollPhase = OWISPS_POLL_IDLE;
+    this->pollTransferDone = 0;
+    this->pollStatusIdx = -1;
+    this->pendingFastPolls = 0;
+    this->offline = false;
+    this->probeBackoff = 0;
+    this->nextProbe.secPastEpoch = 0;
+    this->nextProbe.nsec = 0;
+    this->cacheFile[0] = '\0';
+    this->cachedVersion[0] = '\0';
+    this->firmwareVersion[0] = '\0';
+    this->versionReplyIdx = -1;
+    this->cacheDirty = false;
+    this->cacheMutex = NULL;
+    this->cacheWriteMutex = NULL;
+    this->cacheEvent = NULL;
+    this->cacheExitEvent = NULL;
+    this->cacheExiting = false;
+    this->cacheExitHook = NULL;
+    this->cacheSnapshot = NULL;
+    this->cacheWriteBuffer = NULL;
+    this->cacheSnapshotSize = 0;
+    this->cacheSnapshotSeq = 0;
+    this->cacheWrittenSeq = 0;
+
+    clearBatch();
+    memset(this->axesStatus, 0, sizeof(this->axesStatus));
+    this->forcedRefreshPeriod = idlePollPeriod;
+    this->lastStatusPoll.secPastEpoch = 0;
+    this->lastStatusPoll.nsec = 0;
+    resetStatistics();
+    this->publishedTransactionCount = 0;
+    this->publishedByteCount = 0;
+    this->lastStatsPublish = this->lastStatusPoll;
+    this->trace = (owispsTraceEntry*)calloc(OWISPS_TRACE_SIZE, sizeof(owispsTraceEntry));
+    this->traceCount = 0;
+    this->recordFile = NULL;
+    this->recordMutex = epicsMutexMustCreate();
+
     createParam(AXIS_INIT_PARAMNAME, asynParamOctet, &driverInitParam);
     createParam(AXIS_PREM_PARAMNAME, asynParamOctet, &driverPremParam);
     createParam(AXIS_POST_PARAMNAME, asynParamOctet, &driverPostParam);
+    createParam(AXIS_STOPLATENCY_PARAMNAME, asynParamFloat64, &driverStopLatencyParam);
+    createParam(AXIS_STOPLATENCYMAX_PARAMNAME, asynParamFloat64, &driverStopLatencyMaxParam);
+    createParam(AXIS_LISTPOSITIONS_PARAMNAME, asynParamFloat64Array, &driverListPositionsParam);
+    createParam(AXIS_LISTDWELL_PARAMNAME, asynParamFloat64, &driverListDwellParam);
+    createParam(AXIS_LISTRUN_PARAMNAME, asynParamInt32, &driverListRunParam);
+    createParam(AXIS_LISTINDEX_PARAMNAME, asynParamInt32, &driverListIndexParam);
+    createParam(AXIS_LISTREADBACKS_PARAMNAME, asynParamFloat64Array, &driverListReadbacksParam);
+    createParam(AXIS_CAPTURE_PARAMNAME, asynParamInt32, &driverCaptureParam);
+    createParam(AXIS_CAPTURECOUNT_PARAMNAME, asynParamInt32, &driverCaptureCountParam);
+    createParam(AXIS_CAPTURETIMES_PARAMNAME, asynParamFloat64Array, &driverCaptureTimesParam);
+    createParam(AXIS_CAPTUREPOSITIONS_PARAMNAME, asynParamFloat64Array, &driverCapturePositionsParam);
+    createParam(AXIS_CAPTURESTATUS_PARAMNAME, asynParamInt8Array, &driverCaptureStatusParam);
+    for (int i=0; i<OWISPS_NUM_CMDTYPES; i++) {
+        char param_name[MAX_OWISPS_STRING_SIZE];
+        snprintf(param_name, sizeof(param_name), CTRL_LATENCYMIN_PARAMNAME, commandTypeNames[i]);
+        createParam(param_name, asynParamFloat64, &driverLatencyMinParam[i]);
+        snprintf(param_name, sizeof(param_name), CTRL_LATENCYMEAN_PARAMNAME, commandTypeNames[i]);
+        createParam(param_name, asynParamFloat64, &driverLatencyMeanParam[i]);
+        snprintf(param_name, sizeof(param_name), CTRL_LATENCYP99_PARAMNAME, commandTypeNames[i]);
+        createParam(param_name, asynParamFloat64, &driverLatencyP99Param[i]);
+        snprintf(param_name, sizeof(param_name), CTRL_LATENCYCOUNT_PARAMNAME, commandTypeNames[i]);
+        createParam(param_name, asynParamInt32, &driverLatencyCountParam[i]);
+    }
+    createParam(CTRL_TRANSACTIONRATE_PARAMNAME, asynParamFloat64, &driverTransactionRateParam);
+    createParam(CTRL_BYTERATE_PARAMNAME, asynParamFloat64, &driverByteRateParam);
+    createParam(CTRL_TIMEOUTS_PARAMNAME, asynParamInt32, &driverTimeoutsParam);
+    createParam(CTRL_POLLCYCLE_PARAMNAME, asynParamFloat64, &driverPollCycleParam);
+    createParam(CTRL_STATSRESET_PARAMNAME, asynParamInt32, &driverStatsResetParam);
 
     // Connect to PS controller
     log(ASYN_TRACE_FLOW, "%s:%s: Creating OWIS PS controller %s to asyn %s with %d axes\n", driverName, functionName, portName, asynPortName, numAxes);
@@ -67,6 +235,16 @@ OWISPSController::OWISPSController(const char *portName, const char *asynPortNam
             log(ASYN_TRACE_FLOW, "%s:%s: Setting output acknowledgement to CR\n", driverName, functionName);
             pasynOctetSyncIO->setOutputEos(pasynUserController_, "\r", 1);
         }
+
+        this->pasynUserPriority = pasynManager->createAsynUser(0, 0);
+        status = pasynManager->connectDevice(this->pasynUserPriority, asynPortName, 0);
+        asynInterface *pasynInterface = (status == asynSuccess) ? pasynManager->findInterface(this->pasynUserPriority, asynOctetType, 1) : NULL;
+        if (pasynInterface) {
+            this->pasynOctetPriority = static_cast<asynOctet*>(pasynInterface->pinterface);
+            this->octetPriorityPvt = pasynInterface->drvPvt;
+        } else {
+            log(ASYN_TRACE_ERROR, "%s:%s: cannot create priority lane, STOP will be queued with other commands\n", driverName, functionName);
+        }
     }
 
     // Create the axis objects
@@ -74,9 +252,109 @@ OWISPSController::OWISPSController(const char *portName, const char *asynPortNam
         new OWISPSAxis(this, axis);
     }
 
+    // Restore their configuration, verified by the first poll cycles
+    if (cacheDirectory[0]) {
+        char thread_name[MAX_OWISPS_STRING_SIZE];
+        snprintf(this->cacheFile, sizeof(this->cacheFile), "%s/%s%s", cacheDirectory, portName, OWISPS_CACHE_EXTENSION);
+        if (loadCache()) {
+            log(ASYN_TRACE_FLOW, "%s:%s: axes restored from %s, firmware version %s\n", driverName, functionName, this->cacheFile, this->cachedVersion);
+        }
+        this->cacheSnapshotSize = (numAxes+2)*MAX_OWISPS_STRING_SIZE; // Header, version and axis lines
+        this->cacheSnapshot = (char*)calloc(this->cacheSnapshotSize, 1);
+        this->cacheWriteBuffer = (char*)calloc(this->cacheSnapshotSize, 1);
+        this->cacheMutex = epicsMutexMustCreate();
+        this->cacheWriteMutex = epicsMutexMustCreate();
+        this->cacheEvent = epicsEventMustCreate(epicsEventEmpty);
+        this->cacheExitEvent = epicsEventMustCreate(epicsEventEmpty);
+        snprintf(thread_name, sizeof(thread_name), "%sCache", portName);
+        if (!epicsThreadCreate(thread_name, epicsThreadPriorityLow, epicsThreadGetStackSize(epicsThreadStackSmall), (EPICSTHREADFUNC)OWISPSCacheThreadC, this)) {
+            log(ASYN_TRACE_ERROR, "%s:%s: cannot create cache thread, cache will be written by the poller\n", driverName, functionName);
+            epicsEventDestroy(this->cacheEvent);
+            this->cacheEvent = NULL;
+        }
+        this->cacheExitHook = (OWISPSController**)calloc(1, sizeof(OWISPSController*)); // Exit hooks cannot be removed, see the destructor
+        if (this->cacheExitHook) {
+            *this->cacheExitHook = this;
+            epicsAtExit(OWISPSFlushCacheC, this->cacheExitHook); // Counters changed since the last poll cycle
+        }
+    }
+
+    // From now on, commands and polling go through the I/O thread
+    char thread_name[MAX_OWISPS_STRING_SIZE];
+    snprintf(thread_name, sizeof(thread_name), "%sIO", portName);
+    this->ioQueue = epicsMessageQueueCreate(OWISPS_IO_QUEUE_SIZE, sizeof(owispsIoRequest));
+    if ((!this->ioQueue) || (!epicsThreadCreate(thread_name, epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackMedium), (EPICSTHREADFUNC)OWISPSIoThreadC, this))) {
+        log(ASYN_TRACE_ERROR, "%s:%s: cannot create I/O thread, commands will be written synchronously\n", driverName, functionName);
+        if (this->ioQueue) {
+            epicsMessageQueueDestroy(this->ioQueue);
+            this->ioQueue = NULL;
+        }
+        epicsEventDestroy(this->batchDoneEvent); // Only waited for on the I/O thread
+        this->batchDoneEvent = NULL;
+    }
+
     startPoller(movingPollPeriod, idlePollPeriod, 2);
 }
 
+/** Destroys an OWISPSController object: writes the cache, stops the I/O and cache threads, and releases the link.
+  * Only meant for manually polled controllers without profile, such as those of the replay and the tests:
+  * asynMotorController has no way to stop its poller, nor the profile thread to stop.
+  */
+OWISPSController::~OWISPSController() {
+    owispsIoRequest request;
+    OWISPSAxis *axis;
+
+    if (this->cacheExitHook) {
+        *this->cacheExitHook = NULL; // Left registered, and allocated
+    }
+    if (this->cacheSnapshot) {
+        syncCache();
+        if (this->cacheEvent) {
+            this->cacheExiting = true;
+            epicsEventSignal(this->cacheEvent);
+            epicsEventMustWait(this->cacheExitEvent);
+            epicsEventDestroy(this->cacheEvent);
+        }
+        epicsEventDestroy(this->cacheExitEvent);
+        epicsMutexDestroy(this->cacheMutex);
+        epicsMutexDestroy(this->cacheWriteMutex);
+        free(this->cacheSnapshot);
+        free(this->cacheWriteBuffer);
+    }
+
+    if (this->ioQueue) {
+        memset(&request, 0, sizeof(request));
+        request.type = OWISPS_IO_EXIT;
+        epicsMessageQueueSend(this->ioQueue, &request, sizeof(request));
+        epicsEventMustWait(this->ioExitEvent);
+        epicsMessageQueueDestroy(this->ioQueue);
+        epicsEventDestroy(this->batchDoneEvent);
+    }
+    epicsEventDestroy(this->ioExitEvent);
+
+    if (this->recordFile) {
+        fclose(this->recordFile);
+    }
+    if (this->pasynUserPriority) {
+        pasynManager->disconnect(this->pasynUserPriority);
+        pasynManager->freeAsynUser(this->pasynUserPriority);
+    }
+    if (pasynUserController_) {
+        pasynOctetSyncIO->disconnect(pasynUserController_);
+    }
+
+    for (int i=0; i<numAxes_; i++) {
+        axis = getAxis(i);
+        delete axis;
+    }
+
+    free(this->trace);
+    epicsEventDestroy(this->profilePointEvent);
+    epicsMutexDestroy(this->recordMutex);
+    epicsMutexDestroy(this->ioStatusMutex);
+    epicsMutexDestroy(this->ioMutex);
+}
+
 /** Reports on status of the driver.
   * If level > 0 then error message, firmware version, axes information is printed.
   *
@@ -86,108 +364,1838 @@ OWISPSController::OWISPSController(const char *portName, const char *asynPortNam
 void OWISPSController::report(FILE *fp, int level) {
     asynStatus status = asynError;
 
-    fprintf(fp, "OWIS PS motor controller %s, numAxes=%d, moving poll period=%f, idle poll period=%f\n", this->portName, numAxes_, movingPollPeriod_, idlePollPeriod_);
+    fprintf(fp, "OWIS PS motor controller %s, numAxes=%d, moving poll period=%f, idle poll period=%f, forced refresh period=%f\n", this->portName, numAxes_, movingPollPeriod_, idlePollPeriod_, this->forcedRefreshPeriod);
 
-    if (level > 0) {
-        buildGenericCommand(this->outString_, OWISPS_MSG_CMD);
+    if ((level > 0) && (this->offline)) { // Spare the timeouts
+        fprintf(fp, "    not answering, probed every %.1f s\n", this->probeBackoff);
+    } else if (level > 0) {
+        formatCommand(this->outString_, sizeof(this->outString_), OWISPS_CMD_MSG, 0);
         status = writeReadController();
         if (status == asynSuccess) {
             fprintf(fp, "    error message=%s\n", this->inString_);
         }
 
-        buildGenericCommand(this->outString_, OWISPS_AXESSTAT_CMD);
+        formatCommand(this->outString_, sizeof(this->outString_), OWISPS_CMD_AXESSTAT, 0);
         status = writeReadController();
         if (status == asynSuccess) {
             fprintf(fp, "    axes status=%s\n", this->inString_);
         }
 
-        buildGenericCommand(this->outString_, OWISPS_VERSION_CMD);
+        formatCommand(this->outString_, sizeof(this->outString_), OWISPS_CMD_VERSION, 0);
         status = writeReadController();
         if (status == asynSuccess) {
             fprintf(fp, "    firmware version=%s\n", this->inString_);
         }
     }
+    if (level > 0) {
+        if (this->ioQueue) {
+            fprintf(fp, "    pending I/O requests=%d\n", epicsMessageQueuePending(this->ioQueue));
+        }
+        fprintf(fp, "    poller=%s\n", this->sharedPoller ? "shared" : "own thread");
+        if (this->cacheFile[0]) {
+            fprintf(fp, "    cache=%s, taken with firmware version %s\n", this->cacheFile, this->cachedVersion);
+        }
+    }
+
+    // Call the base class method
+    asynMotorController::report(fp, level);
+}
+
+/** Returns a pointer to an OWISPSAxis object.
+  *
+  * \param[in] pasynUser asynUser structure that encodes the axis index number
+  *
+  * \return OWISPSAxis object or NULL if the axis number encoded in pasynUser is invalid
+  */
+OWISPSAxis* OWISPSController::getAxis(asynUser *pasynUser) {
+    return static_cast<OWISPSAxis*>(asynMotorController::getAxis(pasynUser));
+}
+
+/** Returns a pointer to an OWISPSAxis object.
+  *
+  * \param[in] axisNo Axis index number
+  *
+  * \return OWISPSAxis object or NULL if the axis number encoded in pasynUser is invalid
+  */
+OWISPSAxis* OWISPSController::getAxis(int axisNo) {
+    return static_cast<OWISPSAxis*>(asynMotorController::getAxis(axisNo));
+}
+
+/** Wrapper of writeOctet, to enable the motor at initialization stage (if configured in INIT).
+  *
+  * \param[in] pasynUser asynUser structure
+  * \param[in] value     Value to write
+  * \param[in] maxChars  Number of bytes to write
+  *
+  * \param[out] nActual Number of bytes written
+  *
+  * \return Result of asynMotorController::writeOctet() call
+  */
+asynStatus OWISPSController::writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual) {
+    int function = pasynUser->reason;
+    asynStatus status;
+    OWISPSAxis *pAxis = getAxis(pasynUser);
+    
+    status = asynMotorController::writeOctet(pasynUser, value, maxChars, nActual);
+    if ((status == asynSuccess) && (function == driverInitParam)) {
+        pAxis->executeInit(); // Status posted by the next poll
+        wakeupPoller();
+    }
+
+    return status;
+}
+
+/** Starts or aborts the axis position list, enables or disables the readback capture,
+  * other parameters are handled by asynMotorController.
+  *
+  * \param[in] pasynUser  asynUser structure that encodes the reason and address
+  * \param[in] value      Value to write
+  *
+  * \return asynError if the position list or capture cannot be started, asynSuccess otherwise
+  */
+asynStatus OWISPSController::writeInt32(asynUser *pasynUser, epicsInt32 value) {
+    int function = pasynUser->reason;
+    asynStatus status;
+    OWISPSAxis *pAxis = getAxis(pasynUser);
+
+    if (function == driverStatsResetParam) {
+        resetStatistics();
+        return asynSuccess;
+    }
+    if ((function != driverListRunParam) && (function != driverCaptureParam)) {
+        return asynMotorController::writeInt32(pasynUser, value);
+    }
+    if (!pAxis) {
+        return asynError;
+    }
+
+    if (function == driverCaptureParam) {
+        status = pAxis->enableCapture(value != 0);
+    } else if (value) {
+        status = pAxis->startList();
+    } else {
+        pAxis->abortList();
+        status = asynSuccess;
+    }
+    pAxis->flushParams();
+
+    return status;
+}
+
+/** Sets the targets of the axis position list, in counter steps, other arrays are handled by asynMotorController.
+  *
+  * \param[in] pasynUser  asynUser structure that encodes the reason and address
+  * \param[in] value      Array of targets
+  * \param[in] nElements  Number of targets
+  *
+  * \return asynError if the position list is running or too long
+  */
+asynStatus OWISPSController::writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements) {
+    int function = pasynUser->reason;
+    OWISPSAxis *pAxis = getAxis(pasynUser);
+
+    if (function != driverListPositionsParam) {
+        return asynMotorController::writeFloat64Array(pasynUser, value, nElements);
+    }
+    if ((!pAxis) || (pAxis->listRunning) || (nElements > MAX_OWISPS_LIST_SIZE)) {
+        return asynError;
+    }
+
+    memcpy(pAxis->listPositions, value, nElements*sizeof(double));
+    pAxis->listCount = (int)nElements;
+
+    return asynSuccess;
+}
+
+/** Reads back the targets or readbacks of the axis position list, or the captured reply times and readbacks,
+  * other arrays are handled by asynMotorController.
+  *
+  * \param[in]  pasynUser  asynUser structure that encodes the reason and address
+  * \param[out] value      Array to fill
+  * \param[in]  nElements  Size of the array
+  * \param[out] nIn        Number of elements filled
+  *
+  * \return asynError if the axis does not exist
+  */
+asynStatus OWISPSController::readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nIn) {
+    int function = pasynUser->reason;
+    OWISPSAxis *pAxis = getAxis(pasynUser);
+    size_t count;
+
+    if ((function == driverCaptureTimesParam) || (function == driverCapturePositionsParam)) {
+        if (!pAxis) {
+            return asynError;
+        }
+        *nIn = pAxis->readCapture(function, value, nElements);
+        return asynSuccess;
+    }
+    if ((function != driverListPositionsParam) && (function != driverListReadbacksParam)) {
+        return asynMotorController::readFloat64Array(pasynUser, value, nElements, nIn);
+    }
+    if (!pAxis) {
+        return asynError;
+    }
+
+    count = (function == driverListPositionsParam) ? pAxis->listCount : pAxis->listIndex+(pAxis->listArrived ? 1 : 0);
+    if (count > nElements) {
+        count = nElements;
+    }
+    memcpy(value, (function == driverListPositionsParam) ? pAxis->listPositions : pAxis->listReadbacks, count*sizeof(double));
+    *nIn = count;
+
+    return asynSuccess;
+}
+
+/** Reads back the captured status characters.
+  *
+  * \param[in]  pasynUser  asynUser structure that encodes the reason and address
+  * \param[out] value      Array to fill
+  * \param[in]  nElements  Size of the array
+  * \param[out] nIn        Number of elements filled
+  *
+  * \return asynError if the axis does not exist
+  */
+asynStatus OWISPSController::readInt8Array(asynUser *pasynUser, epicsInt8 *value, size_t nElements, size_t *nIn) {
+    int function = pasynUser->reason;
+    OWISPSAxis *pAxis = getAxis(pasynUser);
+
+    if (function != driverCaptureStatusParam) {
+        return asynMotorController::readInt8Array(pasynUser, value, nElements, nIn);
+    }
+    if (!pAxis) {
+        return asynError;
+    }
+
+    *nIn = pAxis->readCapture(function, value, nElements);
+
+    return asynSuccess;
+}
+
+/** Polls the controller.
+  * Reads the joint axes state, limits and readback positions in pipelined transactions and updates them.
+  * Limits and readback are only queried for moving axes, idle axes due for refresh, and axes whose state changed;
+  * the first two are known beforehand and share the ?ASTAT transaction, the latter need a second one.
+  * The ?ASTAT reply is diffed against the previous one: idle and unchanged axes are skipped altogether.
+  * The whole cycle is skipped when only axes in the cruise phase of a predicted move are moving,
+  * ?ASTAT still being queried at the idle poll period.
+  * The per-axis replies are parsed afterwards by OWISPSAxis::poll().
+  * The phases run back-to-back here; the shared poller runs them one step at a time instead, see pollStep().
+  *
+  * \return Result of writeReadBatch() calls
+  */
+asynStatus OWISPSController::poll() {
+    asynStatus status, changed_status;
+
+    flushCache(); // Counters of the axes polled after the previous cycle
+    if (!beginPollCycle()) {
+        return asynSuccess;
+    }
+    status = writeReadBatch();
+
+    if (processStatusReplies()) {
+        changed_status = writeReadBatch();
+        if (status == asynSuccess) {
+            status = changed_status;
+        }
+    }
+
+    endPollCycle();
+
+    return status;
+}
+
+/** Starts a poll cycle: queues ?ASTAT, and the limits and readback queries of the axes known to be due.
+  * While the controller is not answering, only ?ASTAT is queued, once the probe backoff elapsed:
+  * each cycle then costs a single timeout.
+  *
+  * \return false if the cycle is skipped, nothing being due
+  */
+bool OWISPSController::beginPollCycle(void) {
+    OWISPSAxis* axis;
+    bool astat_due;
+
+    epicsTimeGetCurrent(&this->pollStart);
+    astat_due = epicsTimeDiffInSeconds(&this->pollStart, &this->lastStatusPoll) >= (idlePollPeriod_ - movingPollPeriod_);
+    recordMarker(OWISPS_TRACE_CYCLE, "");
+
+    if (epicsTimeDiffInSeconds(&this->pollStart, &this->lastStatsPublish) >= OWISPS_STATS_PERIOD) {
+        publishStatistics(&this->pollStart);
+    }
+
+    clearBatch();
+    if (this->offline) {
+        if (epicsTimeDiffInSeconds(&this->pollStart, &this->nextProbe) < 0) {
+            return false;
+        }
+        for (int i=0; i<numAxes_; i++) {
+            axis = getAxis(i);
+            if (axis) {
+                axis->clearPollCommands();
+            }
+        }
+        this->pollStatusIdx = queueBatchCommand(OWISPS_CMD_AXESSTAT, 0);
+        this->versionReplyIdx = -1;
+        this->lastStatusPoll = this->pollStart;
+        return true;
+    }
+    this->pollStatusIdx = queueBatchCommand(OWISPS_CMD_AXESSTAT, 0);
+    this->versionReplyIdx = -1;
+    if ((this->cacheFile[0]) && (!this->firmwareVersion[0])) { // Cache to be verified, or controller back
+        this->versionReplyIdx = queueBatchCommand(OWISPS_CMD_VERSION, 0);
+        astat_due = true;
+    }
+    for (int i=0; i<numAxes_; i++) {
+        axis = getAxis(i);
+        if (axis) {
+            axis->clearPollCommands();
+            axis->polledCommandCount = axis->commandCount;
+            if (axis->isDiscoveryDue(&this->pollStart)) {
+                axis->queueDiscoveryCommands(&this->pollStart);
+                astat_due = true;
+            }
+            if (axis->isPollDue(&this->pollStart)) {
+                axis->queuePollCommands(&this->pollStart);
+                astat_due = true;
+            }
+        }
+    }
+    if (!astat_due) {
+        clearBatch();
+        return false;
+    }
+    this->lastStatusPoll = this->pollStart;
+    return true;
+}
+
+/** Diffs the ?ASTAT reply against the previous one, updates the status of the axes that changed and queues their queries.
+  * When ?ASTAT gets no reply, the controller is considered offline at once and probed on an exponential backoff;
+  * when it answers again, all axes are discovered again and their status processed as if just initialized.
+  * A malformed ?ASTAT reply only skips the status processing of this cycle.
+  *
+  * \return true if queries were queued, to be transferred before the axes are polled
+  */
+bool OWISPSController::processStatusReplies(void) {
+    OWISPSAxis* axis;
+    char previous_status;
+    bool status_valid = (getBatchStatus(this->pollStatusIdx) == asynSuccess);
+    static const char *functionName = "processStatusReplies";
+
+    if ((!status_valid) && (this->batchTransferStatus != asynSuccess)) { // No reply at all, not just a malformed one
+        if (!this->offline) {
+            log(ASYN_TRACE_ERROR, "%s:%s: controller %s not answering, axes queries suspended\n", driverName, functionName, this->portName);
+            this->offline = true;
+        }
+        this->probeBackoff = nextProbeBackoff(this->probeBackoff);
+        epicsTimeGetCurrent(&this->nextProbe); // After the timeout: from the cycle start, short intervals would be over already
+        epicsTimeAddSeconds(&this->nextProbe, this->probeBackoff);
+        for (int i=0; i<numAxes_; i++) {
+            axis = getAxis(i);
+            if (axis) {
+                axis->rediscover();
+            }
+        }
+        this->firmwareVersion[0] = '\0';
+        return false;
+    }
+
+    if (this->offline) {
+        log(ASYN_TRACE_ERROR, "%s:%s: controller %s answering again\n", driverName, functionName, this->portName);
+        this->offline = false;
+        this->probeBackoff = 0;
+        memset(this->axesStatus, 0, sizeof(this->axesStatus)); // All axes processed as changed
+        wakeupPoller(); // Discovery at once, then fast polls
+    }
+
+    processVersionReply();
+    for (int i=0; i<numAxes_; i++) {
+        axis = getAxis(i);
+        if ((axis) && (axis->isDiscoveryQueued()) && (axis->processDiscoveryReplies(&this->pollStart))) {
+            this->cacheDirty = true;
+        }
+    }
+    if (!status_valid) {
+        log(ASYN_TRACE_ERROR, "%s:%s: controller %s malformed axes status, skipped\n", driverName, functionName, this->portName);
+        return this->batchPending != this->batchSize;
+    }
+
+    const char *axes_status = getBatchReply(this->pollStatusIdx);
+    int l = strlen(axes_status);
+    for (int i=0; i<l; i++) {
+        axis = getAxis(i);
+        if ((axes_status[i] == this->axesStatus[i]) && (!axis || !axis->isPollQueued())) {
+            continue;
+        }
+        if (axis) {
+            if ((axis->commandCount != axis->polledCommandCount) || (axis->deferredMove)) { // Commanded while on the wire, or not started yet: status is stale
+                continue;
+            }
+            previous_status = axis->axisStatus;
+            axis->updateAxisStatus(axes_status[i]);
+            if ((axis->axisStatus == OWISPS_STATUS_INITIALIZED) || (axis->axisStatus == OWISPS_STATUS_UNKNOWN)) {
+                axis->invalidateSettings(); // Re-initialized or power-cycled
+            }
+            if ((axis->axisStatus != previous_status) && (!axis->isPollQueued())) {
+                axis->queuePollCommands(&this->pollStart);
+            }
+            axis->forceRefresh = false;
+        }
+    }
+    strncpy(this->axesStatus, axes_status, sizeof(this->axesStatus)-1);
+    this->axesStatus[sizeof(this->axesStatus)-1] = '\0';
+
+    if ((this->profileExecuting) && (isProfilePointDone())) {
+        epicsEventSignal(this->profilePointEvent);
+    }
+
+    return this->batchPending != this->batchSize;
+}
+
+/** Ends a poll cycle that was not skipped.
+  *
+  */
+void OWISPSController::endPollCycle(void) {
+    epicsTimeStamp end;
+    epicsTimeGetCurrent(&end);
+    setDoubleParam(driverPollCycleParam, epicsTimeDiffInSeconds(&end, &this->pollStart)*1000.);
+}
+
+/** Polls the axes, as the asynMotorController poller thread does after poll().
+  *
+  * \return Time until the next poll cycle, in seconds, negative to wait for a wakeup
+  */
+double OWISPSController::pollAxes(void) {
+    OWISPSAxis* axis;
+    bool moving, any_moving = false;
+    epicsTimeStamp now;
+    double delay;
+
+    for (int i=0; i<numAxes_; i++) {
+        axis = getAxis(i);
+        if (axis) {
+            moving = false;
+            axis->poll(&moving);
+            if (moving) {
+                any_moving = true;
+            }
+        }
+    }
+    flushCache(); // As soon as an axis is idle with a new counter
+
+    if (this->offline) { // Next probe
+        epicsTimeGetCurrent(&now);
+        delay = epicsTimeDiffInSeconds(&this->nextProbe, &now);
+        return (delay > 0) ? delay : 0;
+    }
+    if (this->pendingFastPolls > 0) {
+        this->pendingFastPolls--;
+        return movingPollPeriod_;
+    }
+    if (any_moving) {
+        return movingPollPeriod_;
+    }
+    return (idlePollPeriod_ > 0) ? idlePollPeriod_ : -1;
+}
+
+/** Hands the poll batch over to the I/O thread, which reschedules the controller on the shared poller once done.
+  * Without I/O thread, the batch is transferred at once.
+  *
+  * \return true if the transfer is ongoing, false if done or there was nothing to transfer
+  */
+bool OWISPSController::startPollTransfer(void) {
+    owispsIoRequest request;
+
+    if (this->batchPending == this->batchSize) {
+        return false;
+    }
+    if (!this->ioQueue) {
+        transferBatch();
+        return false;
+    }
+
+    epicsAtomicSetIntT(&this->pollTransferDone, 0);
+    request.type = OWISPS_IO_POLL;
+    request.axis = -1;
+    request.commands[0] = '\0';
+    epicsMessageQueueSend(this->ioQueue, &request, sizeof(request));
+    return true;
+}
+
+/** Runs the poll cycle up to the next serial transfer, or to its end, for the shared poller.
+  * The controller is locked only while running, not while its poll batch is on the wire.
+  *
+  * \return Time until the next step, in seconds, negative when waiting for the I/O thread or a wakeup
+  */
+double OWISPSController::pollStep(void) {
+    double delay = -1;
+
+    lock();
+    if (shuttingDown_) {
+        unlock();
+        return -1;
+    }
+    if ((this->pollPhase != OWISPS_POLL_IDLE) && (!epicsAtomicGetIntT(&this->pollTransferDone))) { // Woken up while on the wire
+        unlock();
+        return -1;
+    }
+
+    if (this->pollPhase == OWISPS_POLL_IDLE) {
+        if (beginPollCycle()) {
+            this->pollPhase = OWISPS_POLL_STATUS;
+            if (startPollTransfer()) {
+                unlock();
+                return -1;
+            }
+        }
+    }
+    if (this->pollPhase == OWISPS_POLL_STATUS) {
+        this->pollPhase = OWISPS_POLL_CHANGED;
+        if ((processStatusReplies()) && (startPollTransfer())) {
+            unlock();
+            return -1;
+        }
+    }
+    if (this->pollPhase == OWISPS_POLL_CHANGED) {
+        endPollCycle();
+        this->pollPhase = OWISPS_POLL_IDLE;
+    }
+
+    delay = pollAxes();
+    unlock();
+
+    return delay;
+}
+
+/** Runs one poll cycle and polls the axes, as the asynMotorController poller thread does, from the calling thread.
+  * For the replay and benchmark drivers, which pace the poll cycles themselves.
+  *
+  */
+void OWISPSController::pollOnce(void) {
+    OWISPSAxis* axis;
+    bool moving;
+
+    lock();
+    poll();
+    for (int i=0; i<numAxes_; i++) {
+        axis = getAxis(i);
+        if (axis) {
+            axis->poll(&moving);
+        }
+    }
+    unlock();
+}
+
+/** Starts the poller: the shared one if OWISPSCreatePollers was called and the I/O thread runs,
+  * a thread of its own otherwise, none for manually polled controllers.
+  *
+  * \param[in] movingPollPeriod  The time between polls when any axis is moving
+  * \param[in] idlePollPeriod    The time between polls when no axis is moving
+  * \param[in] forcedFastPolls   The number of fast polls after a wakeup
+  *
+  * \return Result of asynMotorController::startPoller() or wakeupPoller() call
+  */
+asynStatus OWISPSController::startPoller(double movingPollPeriod, double idlePollPeriod, int forcedFastPolls) {
+    OWISPSPoller *poller = OWISPSPoller::getShared();
+
+    if (this->manualPolling) { // Periods still needed to tell which axes are due
+        movingPollPeriod_ = movingPollPeriod;
+        idlePollPeriod_ = idlePollPeriod;
+        forcedFastPolls_ = forcedFastPolls;
+        return asynSuccess;
+    }
+    if ((!poller) || (!this->ioQueue) || (!poller->add(this))) { // Without I/O thread, transfers would block the shared threads
+        return asynMotorController::startPoller(movingPollPeriod, idlePollPeriod, forcedFastPolls);
+    }
+
+    movingPollPeriod_ = movingPollPeriod;
+    idlePollPeriod_ = idlePollPeriod;
+    forcedFastPolls_ = forcedFastPolls;
+    this->sharedPoller = poller;
+
+    return wakeupPoller(); // First poll at startup
+}
+
+/** Triggers a poll cycle with forced fast polls, on the shared poller if any; none if manually polled.
+  *
+  */
+asynStatus OWISPSController::wakeupPoller() {
+    if (this->manualPolling) {
+        return asynSuccess;
+    }
+    if (!this->sharedPoller) {
+        return asynMotorController::wakeupPoller();
+    }
+    this->pendingFastPolls = forcedFastPolls_;
+    this->sharedPoller->schedule(this, 0);
+    return asynSuccess;
+}
+
+/** Defers or releases the moves.
+  * While deferred, OWISPSAxis::move() sends everything but PGO; on release, all PGO commands are
+  * written back-to-back in a single write, so that the axes start together.
+  *
+  * \param[in] defer true to defer the moves, false to start the deferred ones
+  *
+  * \return Result of queueController() call
+  */
+asynStatus OWISPSController::setDeferredMoves(bool defer) {
+    asynStatus status = asynSuccess;
+    OWISPSAxis *axis;
+    char sequence[MAX_OWISPS_SEQUENCE_SIZE];
+    size_t length = 0, appended;
+
+    if ((!defer) && (this->movesDeferred)) {
+        sequence[0] = '\0';
+        for (int i=0; i<numAxes_; i++) {
+            axis = getAxis(i);
+            if ((axis) && (axis->deferredMove)) {
+                appended = appendCommand(sequence, sizeof(sequence), length, OWISPS_CMD_POSGO, i);
+                if (appended) {
+                    length = appended;
+                } else {
+                    status = asynError;
+                }
+            }
+        }
+
+        if ((status == asynSuccess) && (length)) {
+            status = queueController(NULL, sequence);
+        }
+
+        for (int i=0; i<numAxes_; i++) {
+            axis = getAxis(i);
+            if ((axis) && (axis->deferredMove)) {
+                axis->deferredMove = false;
+                axis->commandCount++;
+                if (status == asynSuccess) {
+                    axis->predictMotionDone(axis->moveDistance, axis->positionAcceleration);
+                } else {
+                    axis->setIntegerParam(motorStatusDone_, 1);
+                    axis->setStatusProblem(status);
+                    axis->flushParams();
+                }
+            }
+        }
+    }
+
+    this->movesDeferred = defer;
+
+    return status;
+}
+
+/** Allocates the profile arrays and starts the profile execution thread.
+  *
+  * \param[in] maxPoints Maximum number of profile points
+  *
+  * \return Result of asynMotorController::initializeProfile() call
+  */
+asynStatus OWISPSController::initializeProfile(size_t maxPoints) {
+    asynStatus status;
+    char thread_name[MAX_OWISPS_STRING_SIZE];
+    static const char *functionName = "initializeProfile";
+
+    status = asynMotorController::initializeProfile(maxPoints);
+    if ((status == asynSuccess) && (!this->profileExecuteEvent)) {
+        this->profileExecuteEvent = epicsEventMustCreate(epicsEventEmpty);
+        snprintf(thread_name, sizeof(thread_name), "%sProfile", this->portName);
+        if (!epicsThreadCreate(thread_name, epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackMedium), (EPICSTHREADFUNC)OWISPSProfileThreadC, this)) {
+            log(ASYN_TRACE_ERROR, "%s:%s: cannot create profile thread\n", driverName, functionName);
+            status = asynError;
+        }
+    }
+
+    return status;
+}
+
+/** Builds the profile: the point times computed by asynMotorController are the minimum time spent on each point.
+  *
+  * \return asynError if the profile is not initialized, or has no points or axes
+  */
+asynStatus OWISPSController::buildProfile() {
+    asynStatus status;
+    int num_points, use_axis, num_used=0;
+    const char *message = "";
+
+    setIntegerParam(profileBuildState_, PROFILE_BUILD_BUSY);
+    setIntegerParam(profileBuildStatus_, PROFILE_STATUS_UNDEFINED);
+    callParamCallbacks();
+
+    status = asynMotorController::buildProfile();
+    getIntegerParam(profileNumPoints_, &num_points);
+    for (int i=0; i<numAxes_; i++) {
+        if ((getIntegerParam(i, profileUseAxis_, &use_axis) == asynSuccess) && (use_axis)) {
+            num_used++;
+        }
+    }
+
+    if ((!this->profileExecuteEvent) || (status != asynSuccess)) {
+        message = "Profile not initialized";
+        status = asynError;
+    } else if ((num_points < 1) || (num_points > maxProfilePoints_)) {
+        message = "Invalid number of points";
+        status = asynError;
+    } else if (!num_used) {
+        message = "No axis in use";
+        status = asynError;
+    }
+
+    setIntegerParam(profileBuildState_, PROFILE_BUILD_DONE);
+    setIntegerParam(profileBuildStatus_, (status == asynSuccess) ? PROFILE_STATUS_SUCCESS : PROFILE_STATUS_FAILURE);
+    setStringParam(profileBuildMessage_, message);
+    callParamCallbacks();
+
+    return status;
+}
+
+/** Starts the profile execution thread, and returns immediately.
+  *
+  * \return asynError if the profile is already executing or not initialized
+  */
+asynStatus OWISPSController::executeProfile() {
+    int build_status;
+
+    getIntegerParam(profileBuildStatus_, &build_status);
+    if ((!this->profileExecuteEvent) || (this->profileExecuting) || (build_status != PROFILE_STATUS_SUCCESS)) {
+        return asynError;
+    }
+
+    this->profileExecuting = true;
+    this->profileAbortRequested = false;
+    setIntegerParam(profileExecuteState_, PROFILE_EXECUTE_EXECUTING);
+    setIntegerParam(profileExecuteStatus_, PROFILE_STATUS_UNDEFINED);
+    setStringParam(profileExecuteMessage_, "");
+    setIntegerParam(profileNumReadbacks_, 0);
+    callParamCallbacks();
+
+    epicsEventSignal(this->profileExecuteEvent);
+
+    return asynSuccess;
+}
+
+/** Aborts an executing profile, stopping its axes.
+  *
+  * \return Always asynSuccess
+  */
+asynStatus OWISPSController::abortProfile() {
+    OWISPSAxis *axis;
+    int use_axis;
+
+    if (this->profileExecuting) {
+        this->profileAbortRequested = true;
+        for (int i=0; i<numAxes_; i++) {
+            axis = getAxis(i);
+            if ((axis) && (getIntegerParam(i, profileUseAxis_, &use_axis) == asynSuccess) && (use_axis)) {
+                axis->stop(0);
+            }
+        }
+        epicsEventSignal(this->profilePointEvent);
+    }
+
+    return asynSuccess;
+}
+
+/** Tells whether all profile axes reached the current point, as seen by a ?ASTAT sent after their PGO.
+  *
+  */
+bool OWISPSController::isProfilePointDone(void) {
+    OWISPSAxis *axis;
+    int use_axis;
+
+    for (int i=0; i<numAxes_; i++) {
+        axis = getAxis(i);
+        if ((axis) && (getIntegerParam(i, profileUseAxis_, &use_axis) == asynSuccess) && (use_axis)) {
+            if ((axis->deferredMove) || (axis->forceRefresh) || (OWISPSAxis::isMovingStatus(axis->axisStatus))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/** Executes the profiles, point by point: all profile axes are started together (as deferred moves),
+  * the next point is fed as soon as the poller sees them done and the point time has elapsed.
+  * Readbacks and following errors are captured at each point.
+  *
+  */
+void OWISPSController::profileThread(void) {
+    OWISPSAxis *axis;
+    epicsTimeStamp start, now;
+    int num_points, use_axis, point;
+    double readback, remaining;
+    ProfileStatus profile_status;
+    char message[MAX_OWISPS_STRING_SIZE];
+
+    while (true) {
+        epicsEventMustWait(this->profileExecuteEvent);
+
+        lock();
+        getIntegerParam(profileNumPoints_, &num_points);
+        profile_status = PROFILE_STATUS_SUCCESS;
+        snprintf(message, sizeof(message), "Profile completed");
+
+        for (point=0; point<num_points; point++) {
+            if (this->profileAbortRequested) {
+                profile_status = PROFILE_STATUS_ABORT;
+                snprintf(message, sizeof(message), "Profile aborted at point %d", point);
+                break;
+            }
+
+            setIntegerParam(profileCurrentPoint_, point);
+            callParamCallbacks();
+            epicsTimeGetCurrent(&start);
+            epicsEventTryWait(this->profilePointEvent);
+
+            setDeferredMoves(true);
+            for (int i=0; i<numAxes_; i++) {
+                axis = getAxis(i);
+                if ((axis) && (getIntegerParam(i, profileUseAxis_, &use_axis) == asynSuccess) && (use_axis)) {
+                    axis->move(axis->profilePositions_[point], 0, 0, 0, 0);
+                }
+            }
+            if (setDeferredMoves(false) != asynSuccess) {
+                profile_status = PROFILE_STATUS_FAILURE;
+                snprintf(message, sizeof(message), "Cannot start point %d", point);
+                break;
+            }
+
+            unlock();
+            epicsEventStatus wait_status = epicsEventWaitWithTimeout(this->profilePointEvent, OWISPS_PROFILE_POINT_TIMEOUT);
+            lock();
+
+            if (this->profileAbortRequested) {
+                continue; // Reported at the top of the loop
+            }
+            if (wait_status != epicsEventWaitOK) {
+                profile_status = PROFILE_STATUS_TIMEOUT;
+                snprintf(message, sizeof(message), "Timeout at point %d", point);
+                break;
+            }
+
+            for (int i=0; i<numAxes_; i++) {
+                axis = getAxis(i);
+                if ((axis) && (getIntegerParam(i, profileUseAxis_, &use_axis) == asynSuccess) && (use_axis)) {
+                    readback = 0;
+                    getDoubleParam(i, motorPosition_, &readback);
+                    axis->profileReadbacks_[point] = readback;
+                    axis->profileFollowingErrors_[point] = readback - axis->profilePositions_[point];
+                }
+            }
+            setIntegerParam(profileNumReadbacks_, point+1);
+            callParamCallbacks();
+
+            epicsTimeGetCurrent(&now);
+            remaining = profileTimes_[point] - epicsTimeDiffInSeconds(&now, &start);
+            if (remaining > 0) {
+                unlock();
+                epicsThreadSleep(remaining);
+                lock();
+            }
+        }
+
+        if ((point == num_points) && (this->profileAbortRequested)) {
+            profile_status = PROFILE_STATUS_ABORT;
+            snprintf(message, sizeof(message), "Profile aborted at point %d", point-1);
+        }
+
+        this->profileExecuting = false;
+        setIntegerParam(profileExecuteState_, PROFILE_EXECUTE_DONE);
+        setIntegerParam(profileExecuteStatus_, profile_status);
+        setStringParam(profileExecuteMessage_, message);
+        callParamCallbacks();
+        unlock();
+    }
+}
+
+/** Sets the time after which idle axes are refreshed even if their status did not change.
+  * Lets manual moves (e.g. joystick) be seen while idle.
+  *
+  * \param[in] forcedRefreshPeriod Period in seconds
+  */
+void OWISPSController::setForcedRefreshPeriod(double forcedRefreshPeriod) {
+    lock();
+    this->forcedRefreshPeriod = forcedRefreshPeriod;
+    unlock();
+}
+
+/** Empties the pipelined transaction buffers.
+  *
+  */
+void OWISPSController::clearBatch(void) {
+    this->batchOutString[0] = '\0';
+    this->batchOutLength = 0;
+    this->batchSize = 0;
+    this->batchPending = 0;
+    this->batchTransferStatus = asynSuccess;
+}
+
+/** Appends a query to the pipelined transaction, formatted in place.
+  * Only queries are accepted, as exactly one reply is read back per command.
+  *
+  * \param[in] command Query to be appended
+  * \param[in] axis    Axis number, 0-based
+  *
+  * \return Index of the reply slot for this query, -1 if it is not a query or the transaction is full
+  */
+int OWISPSController::queueBatchCommand(owispsCommandId command, int axis) {
+    const owispsCommandDescriptor *descriptor = commandDescriptor(command);
+    size_t length;
+
+    if ((!descriptor) || (descriptor->reply == OWISPS_REPLY_NONE) || (this->batchSize >= MAX_OWISPS_BATCH_SIZE)) {
+        return -1;
+    }
+    length = appendCommand(this->batchOutString, sizeof(this->batchOutString), this->batchOutLength, command, axis);
+    if (!length) {
+        return -1;
+    }
+    this->batchLengths[this->batchSize] = length - this->batchOutLength;
+    if (this->batchOutLength) {
+        this->batchLengths[this->batchSize] -= strlen(OWISPS_BATCH_SEPARATOR);
+    }
+    this->batchOffsets[this->batchSize] = length - this->batchLengths[this->batchSize];
+    this->batchOutLength = length;
+
+    this->batchStatus[this->batchSize] = asynError;
+    this->batchInStrings[this->batchSize][0] = '\0';
+    this->batchTypes[this->batchSize] = descriptor->type;
+    this->batchReplyTypes[this->batchSize] = descriptor->reply;
+    return this->batchSize++;
+}
+
+/** Writes all queries queued since the last transfer in one go, then reads back one reply per query, in order.
+  * A failed read invalidates that and all following replies, as the stream can no longer be trusted.
+  * Replies of previous transfers are kept until clearBatch().
+  * Must be called with the controller locked: the lock is released while the I/O thread is on the wire,
+  * so that a STOP does not have to wait for the whole transaction, and commands can be queued meanwhile.
+  *
+  * \return Status of the last transfer
+  */
+asynStatus OWISPSController::writeReadBatch(void) {
+    owispsIoRequest request;
+
+    if (this->batchPending == this->batchSize) {
+        return asynSuccess;
+    }
+
+    unlock();
+    if (this->ioQueue) {
+        request.type = OWISPS_IO_BATCH;
+        request.axis = -1;
+        request.commands[0] = '\0';
+        epicsMessageQueueSend(this->ioQueue, &request, sizeof(request));
+        epicsEventMustWait(this->batchDoneEvent);
+    } else {
+        transferBatch();
+    }
+    lock();
+
+    return this->batchTransferStatus;
+}
+
+/** Performs the serial transfer of writeReadBatch(), from the I/O thread.
+  *
+  */
+void OWISPSController::transferBatch(void) {
+    asynStatus status;
+    size_t nwrite, nread;
+    int eom_reason;
+    epicsTimeStamp previous;
+
+    epicsMutexMustLock(this->ioMutex);
+
+    pasynOctetSyncIO->flush(pasynUserController_);
+    epicsTimeGetCurrent(&previous);
+    nwrite = this->batchOutLength;
+    status = pasynOctetSyncIO->write(pasynUserController_, this->batchOutString, nwrite, DEFAULT_CONTROLLER_TIMEOUT, &nwrite);
+    epicsAtomicAddSizeT(&this->byteCount, nwrite+1);
+    for (int i=this->batchPending; i<this->batchSize; i++) {
+        traceTransfer(OWISPS_TRACE_QUERY, this->batchOutString+this->batchOffsets[i], this->batchLengths[i], &previous, &previous, status);
+    }
+    for (int i=this->batchPending; i<this->batchSize; i++) {
+        this->batchStatus[i] = status;
+        if (status == asynSuccess) {
+            nread = 0;
+            status = pasynOctetSyncIO->read(pasynUserController_, this->batchInStrings[i], MAX_OWISPS_STRING_SIZE-1, DEFAULT_CONTROLLER_TIMEOUT, &nread, &eom_reason);
+            if (status != asynSuccess) {
+                nread = 0;
+            }
+            this->batchInStrings[i][nread] = '\0';
+            epicsTimeGetCurrent(&this->batchTimes[i]);
+            // Pipelined: each reply costs the time since the previous one
+            recordTransaction(this->batchTypes[i], &previous, &this->batchTimes[i], nread+1, status);
+            traceTransfer(OWISPS_TRACE_REPLY, this->batchInStrings[i], nread, &previous, &this->batchTimes[i], status);
+            previous = this->batchTimes[i];
+            // A malformed reply only invalidates its own slot, the stream is still in step
+            this->batchStatus[i] = ((status == asynSuccess) && (!isReplyValid(this->batchReplyTypes[i], this->batchInStrings[i], nread))) ? asynError : status;
+        }
+    }
+
+    epicsMutexUnlock(this->ioMutex);
+
+    this->batchOutString[0] = '\0';
+    this->batchOutLength = 0;
+    this->batchPending = this->batchSize;
+    this->batchTransferStatus = status;
+}
+
+/** Serves the I/O requests, in order: axes command sequences and poll batches.
+  * Errors writing a sequence are handed over to the axis, which reports them at its next poll.
+  *
+  */
+void OWISPSController::ioThread(void) {
+    owispsIoRequest request;
+    asynStatus status;
+    OWISPSAxis *axis;
+    static const char *functionName = "ioThread";
+
+    while (true) {
+        if (epicsMessageQueueReceive(this->ioQueue, &request, sizeof(request)) != sizeof(request)) {
+            continue;
+        }
+
+        if (request.type == OWISPS_IO_BATCH) {
+            transferBatch();
+            epicsEventSignal(this->batchDoneEvent);
+
+        } else if (request.type == OWISPS_IO_POLL) {
+            transferBatch();
+            epicsAtomicSetIntT(&this->pollTransferDone, 1);
+            this->sharedPoller->schedule(this, 0);
+
+        } else if (request.type == OWISPS_IO_EXIT) {
+            epicsEventSignal(this->ioExitEvent);
+            return;
+
+        } else {
+            epicsTimeStamp start, end;
+            epicsMutexMustLock(this->ioMutex);
+            epicsTimeGetCurrent(&start);
+            status = asynMotorController::writeController(request.commands, DEFAULT_CONTROLLER_TIMEOUT);
+            epicsTimeGetCurrent(&end);
+            epicsMutexUnlock(this->ioMutex);
+            recordTransaction(classifyCommand(request.commands), &start, &end, strlen(request.commands)+1, status);
+            traceTransfer(OWISPS_TRACE_WRITE, request.commands, strlen(request.commands), &start, &end, status);
+
+            axis = getAxis(request.axis);
+            if ((status != asynSuccess) && (axis)) {
+                log(ASYN_TRACE_ERROR, "%s:%s: axis %d failed writing %s\n", driverName, functionName, request.axis, request.commands);
+                epicsMutexMustLock(this->ioStatusMutex);
+                axis->ioStatus = status;
+                epicsMutexUnlock(this->ioStatusMutex);
+            }
+        }
+    }
+}
+
+/** Wrappers of the asynMotorController I/O methods, serialized with the pipelined transactions.
+  *
+  */
+asynStatus OWISPSController::writeController() {
+    asynStatus status;
+    epicsTimeStamp start, end;
+    epicsMutexMustLock(this->ioMutex);
+    epicsTimeGetCurrent(&start);
+    status = asynMotorController::writeController();
+    epicsTimeGetCurrent(&end);
+    epicsMutexUnlock(this->ioMutex);
+    recordTransaction(classifyCommand(this->outString_), &start, &end, strlen(this->outString_)+1, status);
+    traceTransfer(OWISPS_TRACE_WRITE, this->outString_, strlen(this->outString_), &start, &end, status);
+    return status;
+}
+
+asynStatus OWISPSController::writeReadController() {
+    asynStatus status;
+    epicsTimeStamp start, end;
+    epicsMutexMustLock(this->ioMutex);
+    epicsTimeGetCurrent(&start);
+    status = asynMotorController::writeReadController();
+    epicsTimeGetCurrent(&end);
+    epicsMutexUnlock(this->ioMutex);
+    recordTransaction(classifyCommand(this->outString_), &start, &end, strlen(this->outString_)+strlen(this->inString_)+2, status);
+    traceTransfer(OWISPS_TRACE_WRITE, this->outString_, strlen(this->outString_), &start, &start, status);
+    traceTransfer(OWISPS_TRACE_REPLY, this->inString_, (status == asynSuccess) ? strlen(this->inString_) : 0, &start, &end, status);
+    return status;
+}
+
+/** Writes a command through the priority lane, bypassing both the controller lock and the asyn request queue.
+  * Only meant for commands without reply (STOP, MOFF), which can then be interleaved with pending replies.
+  *
+  * \param[in] command Command to be written, without terminator
+  *
+  * \return Result of the write
+  */
+asynStatus OWISPSController::writePriorityController(const char *command) {
+    asynStatus status;
+    size_t nwrite;
+
+    if (!this->pasynOctetPriority) {
+        strcpy(this->outString_, command);
+        return writeController();
+    }
+
+    epicsTimeStamp start, end;
+    epicsTimeGetCurrent(&start);
+    status = pasynManager->lockPort(this->pasynUserPriority);
+    if (status == asynSuccess) {
+        this->pasynUserPriority->timeout = DEFAULT_CONTROLLER_TIMEOUT;
+        status = this->pasynOctetPriority->write(this->octetPriorityPvt, this->pasynUserPriority, command, strlen(command), &nwrite);
+        pasynManager->unlockPort(this->pasynUserPriority);
+    }
+    epicsTimeGetCurrent(&end);
+    recordTransaction(classifyCommand(command), &start, &end, strlen(command)+1, status);
+    traceTransfer(OWISPS_TRACE_PRIORITY, command, strlen(command), &start, &end, status);
+
+    return status;
+}
+
+/** Queues a command sequence to be written by the I/O thread, and returns immediately.
+  * Before the I/O thread is started, the sequence is written synchronously.
+  *
+  * \param[in] axis      Axis on behalf of which the sequence is written, NULL if several
+  * \param[in] commands  CR-separated commands without reply, without final terminator
+  *
+  * \return asynError if the queue is full, asynSuccess otherwise
+  */
+asynStatus OWISPSController::queueController(OWISPSAxis *axis, const char *commands) {
+    owispsIoRequest request;
+
+    if (!this->ioQueue) {
+        strcpy(this->outString_, commands);
+        return writeController();
+    }
+
+    request.type = OWISPS_IO_WRITE;
+    request.axis = axis ? axis->axisNo_ : -1;
+    strncpy(request.commands, commands, sizeof(request.commands)-1);
+    request.commands[sizeof(request.commands)-1] = '\0';
+    if (epicsMessageQueueTrySend(this->ioQueue, &request, sizeof(request))) {
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+/** Accounts one transaction in the link statistics.
+  * Lock-free, may be called from the I/O thread and any thread writing directly.
+  *
+  * \param[in] type   Command type
+  * \param[in] start  Time the transaction started
+  * \param[in] end    Time the transaction ended
+  * \param[in] bytes  Bytes transferred both ways
+  * \param[in] status Result of the transaction
+  */
+void OWISPSController::recordTransaction(owispsCommandType type, const epicsTimeStamp *start, const epicsTimeStamp *end, size_t bytes, asynStatus status) {
+    owispsLatencyHistogram *histogram = &this->latencies[type];
+    int latency_us = (int)(epicsTimeDiffInSeconds(end, start)*1e6);
+    int min_us;
+
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+
+    epicsAtomicIncrSizeT(&this->transactionCount);
+    epicsAtomicAddSizeT(&this->byteCount, bytes);
+    if (status == asynTimeout) {
+        epicsAtomicIncrSizeT(&this->timeoutCount);
+    }
+
+    epicsAtomicIncrSizeT(&histogram->buckets[latencyBucket(latency_us)]);
+    epicsAtomicIncrSizeT(&histogram->count);
+    epicsAtomicAddSizeT(&histogram->sum, latency_us);
+    min_us = epicsAtomicGetIntT(&histogram->min);
+    while (((min_us < 0) || (latency_us < min_us)) && (epicsAtomicCmpAndSwapIntT(&histogram->min, min_us, latency_us) != min_us)) {
+        min_us = epicsAtomicGetIntT(&histogram->min);
+    }
+}
+
+/** Publishes the latencies (in ms) per command type since the last reset, and the link rates since the last publication.
+  *
+  * \param[in] now Current time
+  */
+void OWISPSController::publishStatistics(const epicsTimeStamp *now) {
+    size_t buckets[OWISPS_LATENCY_BUCKETS];
+    size_t count, transactions, bytes;
+    double elapsed = epicsTimeDiffInSeconds(now, &this->lastStatsPublish);
+
+    for (int i=0; i<OWISPS_NUM_CMDTYPES; i++) {
+        owispsLatencyHistogram *histogram = &this->latencies[i];
+        count = epicsAtomicGetSizeT(&histogram->count);
+        for (int b=0; b<OWISPS_LATENCY_BUCKETS; b++) {
+            buckets[b] = epicsAtomicGetSizeT(&histogram->buckets[b]);
+        }
+        setIntegerParam(driverLatencyCountParam[i], (int)count);
+        if (count) {
+            setDoubleParam(driverLatencyMinParam[i], epicsAtomicGetIntT(&histogram->min)/1000.);
+            setDoubleParam(driverLatencyMeanParam[i], epicsAtomicGetSizeT(&histogram->sum)/1000./count);
+            setDoubleParam(driverLatencyP99Param[i], latencyPercentile(buckets, count, 0.99)/1000.);
+        }
+    }
+
+    transactions = epicsAtomicGetSizeT(&this->transactionCount);
+    bytes = epicsAtomicGetSizeT(&this->byteCount);
+    if ((elapsed > 0) && (elapsed < 10*OWISPS_STATS_PERIOD)) {
+        setDoubleParam(driverTransactionRateParam, (transactions-this->publishedTransactionCount)/elapsed);
+        setDoubleParam(driverByteRateParam, (bytes-this->publishedByteCount)/elapsed);
+    }
+    setIntegerParam(driverTimeoutsParam, (int)epicsAtomicGetSizeT(&this->timeoutCount));
+    this->publishedTransactionCount = transactions;
+    this->publishedByteCount = bytes;
+    this->lastStatsPublish = *now;
+
+    callParamCallbacks(0);
+}
+
+/** Appends a command or reply to the trace ring buffer, overwriting the oldest entry.
+  * Lock-free: each caller claims its own slot; an entry being overwritten while dumped may show mixed contents.
+  *
+  * \param[in] kind   OWISPS_TRACE_* kind of transfer
+  * \param[in] text   Command or reply, not necessarily null-terminated
+  * \param[in] length Length of the command or reply
+  * \param[in] start  Time the transfer started
+  * \param[in] end    Time the transfer ended
+  * \param[in] status Result of the transfer
+  */
+void OWISPSController::traceTransfer(char kind, const char *text, size_t length, const epicsTimeStamp *start, const epicsTimeStamp *end, asynStatus status) {
+    owispsTraceEntry *entry;
+    double duration = epicsTimeDiffInSeconds(end, start);
+
+    if (this->recordFile) {
+        recordTranscript(kind, text, length, start, end, status);
+    }
+    if (!this->trace) {
+        return;
+    }
+
+    entry = &this->trace[(epicsAtomicIncrSizeT(&this->traceCount)-1) % OWISPS_TRACE_SIZE];
+    entry->time = *start;
+    entry->duration = (duration > 0) ? (epicsUInt32)(duration*1e6) : 0;
+    entry->kind = kind;
+    entry->status = (char)status;
+    entry->length = (epicsUInt16)length;
+    memcpy(entry->text, text, (length < OWISPS_TRACE_TEXT_SIZE) ? length : OWISPS_TRACE_TEXT_SIZE);
+}
+
+/** Prints the last entries of the serial traffic trace, oldest first.
+  *
+  * \param[in] fp    The file pointer on which the trace will be written
+  * \param[in] count Number of entries, 0 for the whole trace
+  */
+void OWISPSController::dumpTrace(FILE *fp, int count) {
+    char line[2*MAX_OWISPS_STRING_SIZE];
+    size_t total = epicsAtomicGetSizeT(&this->traceCount);
+    size_t first;
+
+    if (!this->trace) {
+        return;
+    }
+    if ((count <= 0) || (count > OWISPS_TRACE_SIZE)) {
+        count = OWISPS_TRACE_SIZE;
+    }
+    first = (total > (size_t)count) ? total-count : 0;
+
+    fprintf(fp, "OWIS PS controller %s trace, %lu entries, last %lu:\n", this->portName, (unsigned long)total, (unsigned long)(total-first));
+    for (size_t i=first; i<total; i++) {
+        formatTraceEntry(&this->trace[i % OWISPS_TRACE_SIZE], line, sizeof(line));
+        fprintf(fp, "%s\n", line);
+    }
+}
+
+/** Formats a trace entry as "<date time> <kind> <duration>us <status> <text>", CR shown as '|'.
+  * Truncated texts end with "...".
+  *
+  */
+void OWISPSController::formatTraceEntry(const owispsTraceEntry *entry, char *buffer, size_t buffer_size) {
+    char time[40];
+    char text[OWISPS_TRACE_TEXT_SIZE+4];
+    size_t len = (entry->length < OWISPS_TRACE_TEXT_SIZE) ? entry->length : OWISPS_TRACE_TEXT_SIZE;
+
+    epicsTimeToStrftime(time, sizeof(time), "%Y/%m/%d %H:%M:%S.%06f", &entry->time);
+    for (size_t i=0; i<len; i++) {
+        text[i] = (entry->text[i] == '\r') ? '|' : entry->text[i];
+    }
+    text[len] = '\0';
+    if (entry->length > OWISPS_TRACE_TEXT_SIZE) {
+        strcat(text, "...");
+    }
+
+    snprintf(buffer, buffer_size, "%s %c %8uus %-5s %s", time, entry->kind, entry->duration,
+             (entry->status == asynSuccess) ? "ok" : ((entry->status == asynTimeout) ? "tmo" : "err"), text);
+}
+
+/** Starts writing a transcript of the serial traffic, poll cycles and moves, replacing any ongoing one.
+  *
+  * \param[in] fileName The transcript file
+  *
+  * \return asynError if the file cannot be created
+  */
+asynStatus OWISPSController::startRecording(const char *fileName) {
+    FILE *fp = fopen(fileName, "w");
+
+    if (!fp) {
+        return asynError;
+    }
+    fprintf(fp, "%s %s %d\n", OWISPS_TRANSCRIPT_HEADER, this->portName, numAxes_);
+
+    stopRecording();
+    epicsMutexMustLock(this->recordMutex);
+    epicsTimeGetCurrent(&this->recordStart);
+    this->recordFile = fp;
+    epicsMutexUnlock(this->recordMutex);
+
+    return asynSuccess;
+}
+
+void OWISPSController::stopRecording(void) {
+    epicsMutexMustLock(this->recordMutex);
+    if (this->recordFile) {
+        fclose(this->recordFile);
+        this->recordFile = NULL;
+    }
+    epicsMutexUnlock(this->recordMutex);
+}
+
+/** Writes a poll cycle, move or homing marker to the transcript being recorded, if any.
+  *
+  * \param[in] kind OWISPS_TRACE_CYCLE, OWISPS_TRACE_MOVE or OWISPS_TRACE_HOME
+  * \param[in] text Marker arguments
+  */
+void OWISPSController::recordMarker(char kind, const char *text) {
+    epicsTimeStamp now;
+
+    if (this->recordFile) {
+        epicsTimeGetCurrent(&now);
+        recordTranscript(kind, text, strlen(text), &now, &now, asynSuccess);
+    }
+}
+
+void OWISPSController::recordTranscript(char kind, const char *text, size_t length, const epicsTimeStamp *start, const epicsTimeStamp *end, asynStatus status) {
+    owispsTranscriptEntry entry;
+    char line[MAX_OWISPS_SEQUENCE_SIZE+MAX_OWISPS_STRING_SIZE];
+
+    if (length >= sizeof(entry.text)) {
+        length = sizeof(entry.text)-1;
+    }
+    memcpy(entry.text, text, length);
+    entry.text[length] = '\0';
+    entry.kind = kind;
+    entry.status = status;
+    entry.duration = epicsTimeDiffInSeconds(end, start);
+
+    epicsMutexMustLock(this->recordMutex);
+    if (this->recordFile) {
+        entry.offset = epicsTimeDiffInSeconds(start, &this->recordStart);
+        formatTranscriptLine(&entry, line, sizeof(line));
+        fputs(line, this->recordFile);
+    }
+    epicsMutexUnlock(this->recordMutex);
+}
+
+/** Formats a transcript line as "<offset> <kind> <duration> <status> <text>\n", times in seconds, CR shown as '|'.
+  *
+  */
+void OWISPSController::formatTranscriptLine(const owispsTranscriptEntry *entry, char *buffer, size_t buffer_size) {
+    int len = snprintf(buffer, buffer_size, "%.6f %c %.6f %d %s\n", entry->offset, entry->kind, entry->duration, entry->status, entry->text);
+
+    for (int i=0; (i<len) && (i<(int)buffer_size); i++) {
+        if (buffer[i] == '\r') {
+            buffer[i] = '|';
+        }
+    }
+}
+
+/** Parses a transcript line, see formatTranscriptLine().
+  *
+  * \return False for comments and malformed lines
+  */
+bool OWISPSController::parseTranscriptLine(const char *line, owispsTranscriptEntry& entry) {
+    int text_start = 0;
+    size_t len;
+
+    if ((!line) || (line[0] == '#')) {
+        return false;
+    }
+    if (sscanf(line, "%lf %c %lf %d %n", &entry.offset, &entry.kind, &entry.duration, &entry.status, &text_start) < 4) {
+        return false;
+    }
+    if ((text_start <= 0) || (text_start > (int)strlen(line))) {
+        text_start = strlen(line);
+    }
+
+    len = strcspn(line+text_start, "\r\n");
+    if (len >= sizeof(entry.text)) {
+        len = sizeof(entry.text)-1;
+    }
+    for (size_t i=0; i<len; i++) {
+        entry.text[i] = (line[text_start+i] == '|') ? '\r' : line[text_start+i];
+    }
+    entry.text[len] = '\0';
+
+    return true;
+}
+
+/** Sets the directory of the axes configuration caches, one file per controller port.
+  * Controllers created afterwards restore their axes from it, and keep it up to date.
+  *
+  * \param[in] directory Cache directory, NULL or empty to disable the cache
+  * \param[in] restore   Whether the saved homed flags are restored at startup
+  */
+void OWISPSController::setCacheDirectory(const char *directory, bool restore) {
+    snprintf(cacheDirectory, sizeof(cacheDirectory), "%s", directory ? directory : "");
+    restoreHomedFlags = restore;
+}
+
+/** Sets whether the controllers created afterwards are polled by their caller only, through pollOnce().
+  * Such controllers start no poller and ignore wakeups, so that nothing else runs a poll cycle concurrently.
+  *
+  * \param[in] manual True for the replay and benchmark drivers
+  */
+void OWISPSController::setManualPolling(bool manual) {
+    manualPollingFlag = manual;
+}
+
+/** Tells whether the controller is only polled by its caller, through pollOnce().
+  *
+  */
+bool OWISPSController::isManualPolling(void) {
+    return this->manualPolling;
+}
+
+/** Hands the cache to the writer thread if anything changed since it was last saved, and the controller firmware version is known.
+  * Called at the end of each poll cycle: only the snapshot is taken under the controller lock.
+  *
+  */
+void OWISPSController::flushCache(void) {
+    bool saved = false;
+
+    lock();
+    if ((this->cacheDirty) && (this->firmwareVersion[0])) {
+        saved = saveCache();
+        this->cacheDirty = false;
+    }
+    unlock();
+
+    if (saved) {
+        if (this->cacheEvent) {
+            epicsEventSignal(this->cacheEvent);
+        } else {
+            writeCache();
+        }
+    }
+}
+
+/** Saves the cache and writes it at once, from the calling thread.
+  * Called at exit, when the writer thread may not run again.
+  *
+  */
+void OWISPSController::syncCache(void) {
+    flushCache();
+    if (this->cacheSnapshot) {
+        writeCache();
+    }
+}
+
+/** Writes the cache file whenever a new snapshot is saved, at most once per OWISPS_CACHE_PERIOD.
+  * Low priority thread, so that file system latencies never delay polling.
+  *
+  */
+void OWISPSController::cacheThread(void) {
+    while (true) {
+        epicsEventMustWait(this->cacheEvent);
+        if (this->cacheExiting) {
+            epicsEventSignal(this->cacheExitEvent);
+            return;
+        }
+        writeCache();
+        epicsThreadSleep(OWISPS_CACHE_PERIOD); // Snapshots saved meanwhile are written at once
+    }
+}
+
+/** Formats the cached configuration of one axis as a line of the cache file.
+  *
+  * \param[in]  entry        Cached configuration
+  * \param[out] buffer       Formatted line, with trailing newline
+  * \param[in]  buffer_size  Size of buffer
+  */
+void OWISPSController::formatCacheLine(const owispsCacheEntry *entry, char *buffer, size_t buffer_size) {
+    snprintf(buffer, buffer_size, "%s %d %d %d %d %ld %d\n", OWISPS_CACHE_AXIS, entry->axis, entry->type, entry->homingType, entry->velocity, entry->counter, entry->homed);
+}
+
+/** Parses an axis line of the cache file, see formatCacheLine().
+  * Lines without counter, from caches taken before counters were saved, are accepted.
+  *
+  * \param[in]  line   Line of the cache file
+  * \param[out] entry  Cached configuration
+  *
+  * \return false if not a valid axis line
+  */
+bool OWISPSController::parseCacheLine(const char *line, owispsCacheEntry& entry) {
+    owispsCacheEntry parsed;
+    int fields;
+
+    if (!line) {
+        return false;
+    }
+    fields = sscanf(line, OWISPS_CACHE_AXIS " %d %d %d %d %ld %d", &parsed.axis, &parsed.type, &parsed.homingType, &parsed.velocity, &parsed.counter, &parsed.homed);
+    if (fields == 4) {
+        parsed.counter = 0;
+        parsed.homed = -1;
+    } else if (fields != 6) {
+        return false;
+    }
+    if ((parsed.axis < 0) || (parsed.type < UNKNOWN) || (parsed.type > BLDC) || (parsed.velocity < 0) || (parsed.homed < -1) || (parsed.homed > 1)) {
+        return false;
+    }
+    entry = parsed;
+    return true;
+}
+
+/** Restores the axes configuration from the cache file.
+  * Axis lines are only trusted after the firmware version line.
+  *
+  * \return false if there is no cache, or it has no firmware version
+  */
+bool OWISPSController::loadCache(void) {
+    char line[MAX_OWISPS_PATH_SIZE];
+    owispsCacheEntry entry;
+    OWISPSAxis *axis;
+    size_t version_len = strlen(OWISPS_CACHE_VERSION);
+    FILE *fp = fopen(this->cacheFile, "r");
+
+    if (!fp) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if ((!strncmp(line, OWISPS_CACHE_VERSION, version_len)) && (line[version_len] == ' ')) {
+            line[version_len+1+strcspn(line+version_len+1, "\r\n")] = '\0';
+            snprintf(this->cachedVersion, sizeof(this->cachedVersion), "%s", line+version_len+1);
+        } else if ((this->cachedVersion[0]) && (parseCacheLine(line, entry))) {
+            axis = getAxis(entry.axis);
+            if (axis) {
+                axis->restoreCache(&entry);
+            }
+        }
+    }
+    fclose(fp);
+
+    return this->cachedVersion[0] != '\0';
+}
+
+/** Saves a snapshot of the discovered axes configuration, as the cache file contents, for writeCache().
+  * Called with the controller locked; no file access.
+  *
+  * \return false if there is no cache
+  */
+bool OWISPSController::saveCache(void) {
+    owispsCacheEntry entry;
+    OWISPSAxis *axis;
+    size_t len;
+
+    if (!this->cacheSnapshot) {
+        return false;
+    }
+
+    epicsMutexMustLock(this->cacheMutex);
+    len = snprintf(this->cacheSnapshot, this->cacheSnapshotSize, "%s %s %d\n%s %s\n", OWISPS_CACHE_HEADER, this->portName, numAxes_, OWISPS_CACHE_VERSION, this->firmwareVersion);
+    for (int i=0; (i<numAxes_) && (len<this->cacheSnapshotSize); i++) {
+        axis = getAxis(i);
+        if ((axis) && (axis->discovered)) {
+            entry.axis = i;
+            entry.type = axis->axisType;
+            entry.homingType = axis->homingType;
+            entry.velocity = axis->positionVelocity;
+            entry.counter = axis->savedCounter;
+            entry.homed = axis->savedHomed;
+            formatCacheLine(&entry, this->cacheSnapshot+len, this->cacheSnapshotSize-len);
+            len += strlen(this->cacheSnapshot+len);
+        }
+    }
+    this->cacheSnapshotSeq++;
+    epicsMutexUnlock(this->cacheMutex);
+
+    snprintf(this->cachedVersion, sizeof(this->cachedVersion), "%s", this->firmwareVersion);
+    return true;
+}
+
+/** Writes the last snapshot to the cache file, unless already written; without the controller lock.
+  * Written aside, then renamed, so that a crash never leaves a truncated cache.
+  *
+  * \return false if the cache cannot be written
+  */
+bool OWISPSController::writeCache(void) {
+    char temp_file[MAX_OWISPS_PATH_SIZE+4];
+    int seq;
+    FILE *fp;
+    bool written = true;
+    static const char *functionName = "writeCache";
+
+    epicsMutexMustLock(this->cacheWriteMutex);
+    epicsMutexMustLock(this->cacheMutex);
+    seq = this->cacheSnapshotSeq;
+    memcpy(this->cacheWriteBuffer, this->cacheSnapshot, this->cacheSnapshotSize);
+    epicsMutexUnlock(this->cacheMutex);
+
+    if (seq != this->cacheWrittenSeq) {
+        snprintf(temp_file, sizeof(temp_file), "%s.new", this->cacheFile);
+        fp = fopen(temp_file, "w");
+        if (fp) {
+            written = (fputs(this->cacheWriteBuffer, fp) >= 0);
+            written = (!fclose(fp)) && written && (!rename(temp_file, this->cacheFile));
+        } else {
+            written = false;
+        }
+        if (written) {
+            this->cacheWrittenSeq = seq;
+        } else {
+            log(ASYN_TRACE_ERROR, "%s:%s: cannot write %s\n", driverName, functionName, this->cacheFile);
+        }
+    }
+    epicsMutexUnlock(this->cacheWriteMutex);
+
+    return written;
+}
+
+/** Reads the firmware version of the poll batch, and checks the cache against it.
+  * A cache taken with another firmware is discarded: the settings not verified by discovery go back to their defaults.
+  *
+  */
+void OWISPSController::processVersionReply(void) {
+    OWISPSAxis *axis;
+    static const char *functionName = "processVersionReply";
+
+    if ((this->versionReplyIdx < 0) || (getBatchStatus(this->versionReplyIdx) != asynSuccess)) {
+        return;
+    }
+    snprintf(this->firmwareVersion, sizeof(this->firmwareVersion), "%s", getBatchReply(this->versionReplyIdx));
+
+    if (strcmp(this->cachedVersion, this->firmwareVersion)) {
+        if (this->cachedVersion[0]) {
+            log(ASYN_TRACE_ERROR, "%s:%s: %s taken with firmware version %s, controller has %s: discarded\n", driverName, functionName, this->cacheFile, this->cachedVersion, this->firmwareVersion);
+            for (int i=0; i<numAxes_; i++) {
+                axis = getAxis(i);
+                if (axis) {
+                    axis->homingType = OWISPS_REF_REFSW0;
+                }
+            }
+        }
+        this->cacheDirty = true;
+    }
+}
+
+/** Clears the latency histograms and the timeout count.
+  *
+  */
+void OWISPSController::resetStatistics(void) {
+    for (int i=0; i<OWISPS_NUM_CMDTYPES; i++) {
+        for (int b=0; b<OWISPS_LATENCY_BUCKETS; b++) {
+            epicsAtomicSetSizeT(&this->latencies[i].buckets[b], 0);
+        }
+        epicsAtomicSetSizeT(&this->latencies[i].count, 0);
+        epicsAtomicSetSizeT(&this->latencies[i].sum, 0);
+        epicsAtomicSetIntT(&this->latencies[i].min, -1);
+    }
+    epicsAtomicSetSizeT(&this->timeoutCount, 0);
+}
+
+/** Accessors to the replies of the last pipelined transaction.
+  *
+  */
+const char* OWISPSController::getBatchReply(int index) {
+    if ((index < 0) || (index >= this->batchSize)) {
+        return "";
+    }
+    return this->batchInStrings[index];
+}
+
+asynStatus OWISPSController::getBatchStatus(int index) {
+    if ((index < 0) || (index >= this->batchSize)) {
+        return asynError;
+    }
+    return this->batchStatus[index];
+}
+
+/** Gives the descriptor of a command, NULL if unknown.
+  *
+  */
+const owispsCommandDescriptor* OWISPSController::commandDescriptor(owispsCommandId command) {
+    if ((command < 0) || (command >= OWISPS_NUM_CMDS)) {
+        return NULL;
+    }
+    return &commandTable[command];
+}
+
+/** Formats a decimal integer, without terminator.
+  *
+  * \return Number of characters written, 0 if the buffer is too small
+  */
+size_t OWISPSController::formatInteger(char *buffer, size_t buffer_size, long value) {
+    char digits[24];
+    size_t count = 0, length;
+    unsigned long magnitude = (value < 0) ? 0UL-(unsigned long)value : (unsigned long)value;
+
+    do {
+        digits[count++] = '0' + (char)(magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    length = count + ((value < 0) ? 1 : 0);
+    if ((!buffer) || (length > buffer_size)) {
+        return 0;
+    }
+    if (value < 0) {
+        *buffer++ = '-';
+    }
+    while (count) {
+        *buffer++ = digits[--count];
+    }
+    return length;
+}
+
+/** Builds a command from its descriptor, e.g. "PSET1=100": the axis is sent 1-based, the value only if the command takes one.
+  * Nothing is written if the command does not fit.
+  *
+  * \param[out] buffer       Command, NUL-terminated
+  * \param[in]  buffer_size  Size of the buffer
+  * \param[in]  command      Command to build
+  * \param[in]  axis         Axis number, 0-based
+  * \param[in]  value        Value
+  *
+  * \return Length of the command, 0 if unknown or too long
+  */
+size_t OWISPSController::formatCommand(char *buffer, size_t buffer_size, owispsCommandId command, int axis, long value) {
+    char arguments[MAX_OWISPS_STRING_SIZE];
+    size_t length = 0, n;
+    const owispsCommandDescriptor *descriptor = commandDescriptor(command);
+
+    if ((!buffer) || (!descriptor)) {
+        return 0;
+    }
+
+    if (descriptor->args != OWISPS_ARGS_NONE) {
+        length = formatInteger(arguments, sizeof(arguments), axis+1);
+        if (descriptor->args == OWISPS_ARGS_AXIS_VALUE) {
+            arguments[length++] = '=';
+            n = formatInteger(arguments+length, sizeof(arguments)-length, value);
+            length += n;
+        }
+    }
+    if (descriptor->length + length >= buffer_size) {
+        return 0;
+    }
+
+    memcpy(buffer, descriptor->name, descriptor->length);
+    memcpy(buffer+descriptor->length, arguments, length);
+    length += descriptor->length;
+    buffer[length] = '\0';
+    return length;
+}
+
+/** Appends a command to a CR-separated sequence or pipelined transaction buffer of known length, see formatCommand().
+  *
+  * \return New length of the buffer, 0 if the command does not fit
+  */
+size_t OWISPSController::appendCommand(char *buffer, size_t buffer_size, size_t length, owispsCommandId command, int axis, long value) {
+    size_t sep_len = length ? strlen(OWISPS_BATCH_SEPARATOR) : 0;
+    size_t n;
 
-    // Call the base class method
-    asynMotorController::report(fp, level);
+    if ((!buffer) || (length + sep_len >= buffer_size)) {
+        return 0;
+    }
+    n = formatCommand(buffer+length+sep_len, buffer_size-length-sep_len, command, axis, value);
+    if (!n) {
+        buffer[length] = '\0';
+        return 0;
+    }
+    memcpy(buffer+length, OWISPS_BATCH_SEPARATOR, sep_len);
+    return length + sep_len + n;
 }
 
-/** Returns a pointer to an OWISPSAxis object.
-  *
-  * \param[in] pasynUser asynUser structure that encodes the axis index number
+/** Tells whether a reply has the shape its command promises.
   *
-  * \return OWISPSAxis object or NULL if the axis number encoded in pasynUser is invalid
+  * \param[in] type    Expected reply type
+  * \param[in] reply   Reply, without EOS
+  * \param[in] length  Length of the reply
   */
-OWISPSAxis* OWISPSController::getAxis(asynUser *pasynUser) {
-    return static_cast<OWISPSAxis*>(asynMotorController::getAxis(pasynUser));
+bool OWISPSController::isReplyValid(owispsReplyType type, const char *reply, size_t length) {
+    long value;
+
+    switch (type) {
+        case OWISPS_REPLY_INTEGER:
+            return (length > 0) && (OWISPSAxis::parseInteger(reply, length, value) == length);
+        case OWISPS_REPLY_STATUS:
+            return length > 0;
+        default:
+            return true;
+    }
 }
 
-/** Returns a pointer to an OWISPSAxis object.
-  *
-  * \param[in] axisNo Axis index number
+/** Tells the type of a command, or of the last command of a CR-separated sequence, for the link statistics.
   *
-  * \return OWISPSAxis object or NULL if the axis number encoded in pasynUser is invalid
+  * \param[in] commands Command or sequence
   */
-OWISPSAxis* OWISPSController::getAxis(int axisNo) {
-    return static_cast<OWISPSAxis*>(asynMotorController::getAxis(axisNo));
+owispsCommandType OWISPSController::classifyCommand(const char *commands) {
+    const char *command = commands;
+    const char *separator;
+
+    if (!commands) {
+        return OWISPS_CMDTYPE_OTHER;
+    }
+    while (((separator = strstr(command, OWISPS_BATCH_SEPARATOR)) != NULL) && (separator[1])) {
+        command = separator+1;
+    }
+
+    if (!strncmp(command, "?ASTAT", 6)) return OWISPS_CMDTYPE_ASTAT;
+    if (!strncmp(command, "?ESTAT", 6)) return OWISPS_CMDTYPE_ESTAT;
+    if (!strncmp(command, "?CNT", 4)) return OWISPS_CMDTYPE_CNT;
+    if ((!strncmp(command, "PSET", 4)) || (!strncmp(command, "PGO", 3))) return OWISPS_CMDTYPE_MOVE;
+    if (!strncmp(command, "REF", 3)) return OWISPS_CMDTYPE_HOME;
+    if (!strncmp(command, "STOP", 4)) return OWISPS_CMDTYPE_STOP;
+    return OWISPS_CMDTYPE_OTHER;
 }
 
-/** Wrapper of writeOctet, to enable the motor at initialization stage (if configured in INIT).
-  *
-  * \param[in] pasynUser asynUser structure
-  * \param[in] value     Value to write
-  * \param[in] maxChars  Number of bytes to write
-  *
-  * \param[out] nActual Number of bytes written
+/** Gives the histogram bucket of a latency: bucket k holds [2^k, 2^(k+1)) us, bucket 0 also holds 0 us.
   *
-  * \return Result of callParamCallbacks() call
   */
-asynStatus OWISPSController::writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual) {
-    int function = pasynUser->reason;
-    asynStatus status;
-    OWISPSAxis *pAxis = getAxis(pasynUser);
-    
-    status = asynMotorController::writeOctet(pasynUser, value, maxChars, nActual);
-    if ((status == asynSuccess) && (function == driverInitParam)) {
-        pAxis->executeInit();
-    }
+int OWISPSController::latencyBucket(int latency_us) {
+    int bucket = 0;
 
-    return callParamCallbacks();
+    while ((latency_us > 1) && (bucket < OWISPS_LATENCY_BUCKETS-1)) {
+        latency_us >>= 1;
+        bucket++;
+    }
+    return bucket;
 }
 
-/** Polls the controller.
-  * Reads the joint axes state and updates them.
+/** Estimates a latency percentile from the histogram, as the upper bound of the bucket holding it.
   *
-  * \return Result of writeReadController() call
+  * \param[in] buckets  Histogram buckets
+  * \param[in] count    Number of samples
+  * \param[in] fraction Percentile, e.g. 0.99
+  *
+  * \return Latency in us, 0 if there are no samples
   */
-asynStatus OWISPSController::poll() {
-    asynStatus status;
-    OWISPSAxis* axis;
+double OWISPSController::latencyPercentile(const size_t *buckets, size_t count, double fraction) {
+    size_t cumulated = 0;
 
-    buildGenericCommand(this->outString_, OWISPS_AXESSTAT_CMD);
-    status = writeReadController();
-    if (status == asynSuccess) {
-        int l = strlen(this->inString_);
-        for (int i=0; i<l; i++) {
-            axis = getAxis(i);
-            if (axis) {
-                axis->updateAxisStatus(this->inString_[i]);
-            }
+    if (!count) {
+        return 0;
+    }
+    for (int b=0; b<OWISPS_LATENCY_BUCKETS; b++) {
+        cumulated += buckets[b];
+        if (cumulated >= fraction*count) {
+            return (double)(1 << (b+1));
         }
     }
-
-    return status;
+    return (double)(1 << OWISPS_LATENCY_BUCKETS);
 }
 
-/** The following methods generate a command string to be sent to the controller.
+/** Computes the interval until the next probe of a controller not answering: doubled at each failed probe, bounded.
+  *
+  * \param[in] backoff Current interval, 0 if the controller was answering until now
   *
+  * \return Next interval, in seconds
   */
-bool OWISPSController::buildGenericCommand(char *buffer, const char *command_format) {
-    if ((!buffer) || (!command_format)) {
-        return false;
+double OWISPSController::nextProbeBackoff(double backoff) {
+    if (backoff < OWISPS_PROBE_MIN_PERIOD) {
+        return OWISPS_PROBE_MIN_PERIOD;
     }
-    sprintf(buffer, "%s", command_format);
-    return true;
+    return (2*backoff < OWISPS_PROBE_MAX_PERIOD) ? 2*backoff : OWISPS_PROBE_MAX_PERIOD;
 }
 
 /** Provide a class method to be used instead of asynPrint().
@@ -212,34 +2220,69 @@ void OWISPSController::log(int reason, const char *format, ...) {
   * \param[in] axisNo Index number of this axis, range 0 to pC->numAxes_-1
   */
 OWISPSAxis::OWISPSAxis(OWISPSController *pC, int axisNo): asynMotorAxis(pC, axisNo), pC_(pC) {
-    asynStatus status;
-    int lim_switches;
-
     this->axisType = UNKNOWN;
     this->axisStatus = OWISPS_STATUS_UNKNOWN;
     this->homingType = OWISPS_REF_REFSW0;
+    this->positionVelocity = 0;
+    this->positionAcceleration = 0;
+    this->limitsReplyIdx = -1;
+    this->counterReplyIdx = -1;
+    this->typeReplyIdx = -1;
+    this->velocityReplyIdx = -1;
+    this->lastRefresh.secPastEpoch = 0;
+    this->lastRefresh.nsec = 0;
+    this->discovered = false;
+    this->lastDiscovery = this->lastRefresh;
+    this->savedCounter = 0;
+    this->savedHomed = -1;
+    this->restorePending = false;
+    this->forceRefresh = false;
+    this->paramsChanged = false;
+    this->expectedDone = this->lastRefresh;
+    this->expectedDuration = -1;
+    this->commandCount = 0;
+    this->polledCommandCount = 0;
+    this->powerError = false;
+    this->sequence[0] = '\0';
+    this->sequenceLength = 0;
+    this->ioStatus = asynSuccess;
+    this->coordinateMode = OWISPS_COORD_UNKNOWN;
+    this->deferredMove = false;
+    this->moveDistance = 0;
+    this->listCount = 0;
+    this->listIndex = 0;
+    this->listRunning = false;
+    this->listArrived = false;
+    this->listArrival = this->lastRefresh;
+
+    this->captureTimes = NULL;
+    this->capturePositions = NULL;
+    this->captureStatus = NULL;
+    this->captureHead = 0;
+    this->captureCount = 0;
+    this->captureEnabled = false;
+
+    setIntegerParam(pC->driverListRunParam, 0);
+    setIntegerParam(pC->driverCaptureParam, 0);
+    setIntegerParam(pC->driverCaptureCountParam, 0);
+    setIntegerParam(pC->driverListIndexParam, 0);
+    setDoubleParam(pC->driverListDwellParam, 0);
+
+    // Discovered by the first poll cycles, not to hold the IOC startup on serial round trips
+    setIntegerParam(pC->motorStatusCommsError_, 1);
 
-    buildGenericCommand(pC->outString_, OWISPS_AXISTYPE_CMD, axisNo);
-    status = pC->writeReadController();
-    if (updateAxisType(status, pC_->inString_, this->axisType, &status)) {
-        buildGenericCommand(pC->outString_, OWISPS_LIMSTAT_CMD, axisNo);
-        status = pC->writeReadController();
-        if (updateAxisLimitsStatus(status, pC_->inString_, lim_switches, &status)) {
-            if (lim_switches & OWISPS_POWSTG_ERROR) {
-                setStatusProblem(asynError);
-            }
-        } else {
-            setStatusProblem(status);
-        }
-    }
-
-    if (this->axisType == UNKNOWN) {
-        setIntegerParam(pC->motorStatusCommsError_, 1);
-    }
-  
     callParamCallbacks();
 }
 
+/** Destroys an OWISPSAxis object, see ~OWISPSController().
+  *
+  */
+OWISPSAxis::~OWISPSAxis() {
+    free(this->captureTimes);
+    free(this->capturePositions);
+    free(this->captureStatus);
+}
+
 /** Reports on status of the axis.
   * If level > 0 then detailed axis information (type, homing, status, readback, etc.) is printed.
   *
@@ -252,7 +2295,7 @@ void OWISPSAxis::report(FILE *fp, int level) {
     int lim_switches=0, readback_counter=0, target=0, velocity=0;
 
     if (level > 0) {
-        OWISPSController::buildGenericCommand(pC_->outString_, OWISPS_AXESSTAT_CMD);
+        OWISPSController::formatCommand(pC_->outString_, sizeof(pC_->outString_), OWISPS_CMD_AXESSTAT, 0);
         status = pC_->writeReadController();
         if (status == asynSuccess) {
             if (strlen(pC_->inString_) > (unsigned)this->axisNo_) {
@@ -260,25 +2303,25 @@ void OWISPSAxis::report(FILE *fp, int level) {
             }
         }
 
-        buildGenericCommand(pC_->outString_, OWISPS_LIMSTAT_CMD, this->axisNo_);
+        OWISPSController::formatCommand(pC_->outString_, sizeof(pC_->outString_), OWISPS_CMD_LIMSTAT, this->axisNo_);
         status = pC_->writeReadController();
         if (status == asynSuccess) {
             lim_switches = atoi(pC_->inString_);
         }
 
-        buildGenericCommand(pC_->outString_, OWISPS_GETCOUNTER_CMD, this->axisNo_);
+        OWISPSController::formatCommand(pC_->outString_, sizeof(pC_->outString_), OWISPS_CMD_GETCOUNTER, this->axisNo_);
         status = pC_->writeReadController();
         if (status == asynSuccess) {
             readback_counter = atoi(pC_->inString_);
         }
 
-        buildGenericCommand(pC_->outString_, OWISPS_GETTARGET_CMD, this->axisNo_);
+        OWISPSController::formatCommand(pC_->outString_, sizeof(pC_->outString_), OWISPS_CMD_GETTARGET, this->axisNo_);
         status = pC_->writeReadController();
         if (status == asynSuccess) {
             target = atoi(pC_->inString_);
         }
 
-        buildGenericCommand(pC_->outString_, OWISPS_GETPOSVEL_CMD, this->axisNo_);
+        OWISPSController::formatCommand(pC_->outString_, sizeof(pC_->outString_), OWISPS_CMD_GETPOSVEL, this->axisNo_);
         status = pC_->writeReadController();
         if (status == asynSuccess) {
             velocity = atoi(pC_->inString_);
@@ -319,6 +2362,9 @@ void OWISPSAxis::report(FILE *fp, int level) {
 
 /** Moves the axis to a different target position, executing the desired user operation defined in PREM.
   * Warning: only implemented for stepper-motors in open-loop!
+  * Velocity and acceleration are only sent when positive and different from the last ones sent.
+  * When moves are deferred, PGO is left to OWISPSController::setDeferredMoves().
+  * The command sequence is queued to the controller I/O thread, errors are reported at the next poll.
   *
   * \param[in] position      The desired target position
   * \param[in] relative      1 for relative position
@@ -326,36 +2372,67 @@ void OWISPSAxis::report(FILE *fp, int level) {
   * \param[in] maxVelocity   Motion parameter
   * \param[in] acceleration  Motion parameter
   *
-  * \return Result of callParamCallbacks() call
+  * \return Result of startMove() call, the parameters are posted by asynMotorController and the next poll
   */
 asynStatus OWISPSAxis::move(double position, int relative, double minVelocity, double maxVelocity, double acceleration) {
+    return startMove(position, relative, maxVelocity, acceleration);
+}
+
+/** Issues the move command sequence, see move().
+  *
+  * \return asynError if the axis cannot move or the sequence cannot be queued
+  */
+asynStatus OWISPSAxis::startMove(double position, int relative, double maxVelocity, double acceleration) {
     asynStatus status = asynError;
+    char command[MAX_OWISPS_STRING_SIZE];
     int is_disabled = (this->axisStatus==OWISPS_STATUS_UNKNOWN) || (this->axisStatus==OWISPS_STATUS_INITIALIZED) || (this->axisStatus==OWISPS_STATUS_DISABLED);
 
+    if (pC_->recordFile) {
+        snprintf(command, sizeof(command), "%d %.17g %d %.17g %.17g", this->axisNo_, position, relative, maxVelocity, acceleration);
+        pC_->recordMarker(OWISPS_TRACE_MOVE, command);
+    }
+
     switch(this->axisType) {
         case STEPPER_OPENLOOP:
+            beginSequence();
             status = executePrem();
             if ((status == asynError) && (is_disabled)) {
                 // Motor wasn't ready and no prem command defined
             } else {
                 setIntegerParam(pC_->motorStatusDone_, 0);
+                this->forceRefresh = true;
+                this->commandCount++;
 
-                if (relative) {
-                    buildGenericCommand(pC_->outString_, OWISPS_RELCOORD_CMD, this->axisNo_);
-                    status = pC_->writeController();
-                } else {
-                    buildGenericCommand(pC_->outString_, OWISPS_ABSCOORD_CMD, this->axisNo_);
-                    status = pC_->writeController();
+                status = appendCoordinateMode(relative ? OWISPS_COORD_RELATIVE : OWISPS_COORD_ABSOLUTE);
+
+                if (status == asynSuccess) {
+                    status = appendVelocity(maxVelocity, acceleration);
                 }
 
                 if (status == asynSuccess) {
-                    buildMoveCommand(pC_->outString_, this->axisNo_, position);
-                    status = pC_->writeController();
+                    status = appendSequence(OWISPS_CMD_POSSET, (long)position);
+                }
 
-                    if (status == asynSuccess) {
-                        buildGenericCommand(pC_->outString_, OWISPS_POSGO_CMD, this->axisNo_);
-                        status = pC_->writeController();
-                    }
+                if (status == asynSuccess) {
+                    double readback = 0;
+                    getDoubleParam(pC_->motorPosition_, &readback);
+                    this->moveDistance = relative ? position : position-readback;
+                }
+
+                if ((status == asynSuccess) && (!pC_->movesDeferred)) {
+                    status = appendSequence(OWISPS_CMD_POSGO);
+                }
+
+                if (status == asynSuccess) {
+                    status = sendSequence();
+                }
+
+                if (status != asynSuccess) {
+                    invalidateSettings();
+                } else if (pC_->movesDeferred) {
+                    this->deferredMove = true; // PGO issued by the controller, together with the other axes
+                } else {
+                    predictMotionDone(this->moveDistance, this->positionAcceleration);
                 }
             }
 
@@ -363,141 +2440,563 @@ asynStatus OWISPSAxis::move(double position, int relative, double minVelocity, d
             break;
 
         default:
-            setStatusProblem(asynError);
+            status = asynError;
+            setStatusProblem(status);
             break;
     }
 
-    return callParamCallbacks();
+    return status;
 }
 
 /** Starts the axis homing procedure, executing the desired user operation defined in PREM.
   * Warning: only implemented for stepper-motors in open-loop!
   * Currently hardwired to OWISPS_REF_REFSW0, equivalent to "REF?=4".
+  * Only the acceleration is honoured, the controller uses its own reference velocities.
   *
   * \param[in] minVelocity   Motion parameter
   * \param[in] maxVelocity   Motion parameter
   * \param[in] acceleration  Motion parameter
   * \param[in] forwards      1 if user wants to home forward, 0 for reverse
   *
-  * \return Result of callParamCallbacks() call
+  * \return asynError if the axis cannot home or the sequence cannot be queued
   */
 asynStatus OWISPSAxis::home(double minVelocity, double maxVelocity, double acceleration, int forwards) {
     asynStatus status = asynError;
+    char command[MAX_OWISPS_STRING_SIZE];
     int is_disabled = (this->axisStatus==OWISPS_STATUS_UNKNOWN) || (this->axisStatus==OWISPS_STATUS_INITIALIZED) || (this->axisStatus==OWISPS_STATUS_DISABLED);
 
+    if (pC_->recordFile) {
+        snprintf(command, sizeof(command), "%d %.17g", this->axisNo_, acceleration);
+        pC_->recordMarker(OWISPS_TRACE_HOME, command);
+    }
+
     switch(this->axisType) {
         case STEPPER_OPENLOOP:
+            beginSequence();
             status = executePrem();
             if ((status == asynError) && (is_disabled)) {
                 // Motor wasn't ready and no prem command defined
             } else {
                 setIntegerParam(pC_->motorStatusHome_, 1);
                 setIntegerParam(pC_->motorStatusDone_, 0);
-                buildHomeCommand(pC_->outString_, this->axisNo_, this->homingType);
-                status = pC_->writeController();
+                this->forceRefresh = true;
+                this->commandCount++;
+                this->expectedDuration = -1;
+                status = appendVelocity(0, acceleration);
+                if (status == asynSuccess) {
+                    status = appendSequence(OWISPS_CMD_HOME, this->homingType);
+                }
+                if (status == asynSuccess) {
+                    status = sendSequence();
+                }
             }
 
             setStatusProblem(status);
             break;
 
         default:
-            setStatusProblem(asynError);
+            setStatusProblem(status);
             break;
     }
 
-    return callParamCallbacks();
+    return status;
+}
+
+/** Stops an ongoing motion.
+  * STOP goes through the controller priority lane, ahead of any pending poll traffic.
+  * No callbacks are posted here: the axis is forced into the poll cycle the wakeup triggers,
+  * which posts the deceleration and the new status at once.
+  *
+  * \param[in] acceleration  Motion parameter
+  *
+  * \return Result of writePriorityController() call
+  */
+asynStatus OWISPSAxis::stop(double acceleration) {
+    asynStatus status = asynError;
+    char command[MAX_OWISPS_STRING_SIZE];
+    epicsTimeStamp start, end;
+
+    this->deferredMove = false;
+    abortList();
+
+    if (this->axisType != UNKNOWN) {
+        epicsTimeGetCurrent(&start);
+        OWISPSController::formatCommand(command, sizeof(command), OWISPS_CMD_STOP, this->axisNo_);
+        status = pC_->writePriorityController(command);
+        epicsTimeGetCurrent(&end);
+        updateStopLatency(epicsTimeDiffInSeconds(&end, &start));
+    }
+
+    setStatusProblem(status);
+    this->forceRefresh = true;     // Not in cruise anymore: the prediction no longer holds
+    this->expectedDuration = -1;
+    pC_->wakeupPoller(); // Decelerating: posted, with the new status, by the next poll
+
+    return status;
+}
+
+/** Forces the axis readback position to some value.
+  *
+  * \param[in] position  The desired readback position
+  *
+  * \return Result of sendSequence() call
+  */
+asynStatus OWISPSAxis::setPosition(double position) {
+    asynStatus status = asynError;
+
+    beginSequence();
+    status = appendSequence(OWISPS_CMD_SETCOUNTER, (long)position);
+    if (status == asynSuccess) {
+        status = sendSequence();
+    }
+    this->forceRefresh = true;
+
+    setStatusProblem(status);
+
+    return status;
+}
+
+/** Polls the axis.
+  * Parses the limits state and readback position replies of the controller poll batch and calls setIntegerParam() or setDoubleParam() for each item that it polls.
+  * Axes left out of this poll cycle by the controller only report their moving state, and failed command sequences.
+  *
+  * \param[out] moving A flag that is set indicating that the axis is moving (1) or done (0).
+  *
+  * \return Result of flushParams() call
+  */
+asynStatus OWISPSAxis::poll(bool *moving) { 
+    asynStatus status = asynError;
+    asynStatus io_status;
+    int lim_switches;
+    long readback_counter;
+
+    epicsMutexMustLock(pC_->ioStatusMutex);
+    io_status = this->ioStatus;
+    this->ioStatus = asynSuccess;
+    epicsMutexUnlock(pC_->ioStatusMutex);
+
+    if (this->axisType != UNKNOWN) {
+
+        *moving = isMovingStatus(this->axisStatus);
+
+        if (!isPollQueued()) { // Idle and unchanged, nothing new to parse
+            if (io_status != asynSuccess) {
+                invalidateSettings();
+                setStatusProblem(io_status);
+            }
+            return flushParams();
+        }
+
+        status = pC_->getBatchStatus(this->limitsReplyIdx);
+        if (updateAxisLimitsStatus(status, pC_->getBatchReply(this->limitsReplyIdx), lim_switches, &status)) {
+            if (lim_switches & OWISPS_POWSTG_ERROR) { // Disconnected or power error?
+                status = asynError;
+                if (!this->powerError) {
+                    char command[MAX_OWISPS_STRING_SIZE];
+                    OWISPSController::formatCommand(command, sizeof(command), OWISPS_CMD_MOFF, this->axisNo_);
+                    pC_->writePriorityController(command);
+                    this->powerError = true;
+                }
+
+            } else {
+                this->powerError = false;
+
+                setIntegerParam(pC_->motorStatusLowLimit_, (lim_switches & OWISPS_LOWLIM_DEC) ? 1 : 0);
+                setIntegerParam(pC_->motorStatusHighLimit_, (lim_switches & OWISPS_HIGHLIM_DEC) ? 1 : 0);
+
+                status = pC_->getBatchStatus(this->counterReplyIdx);
+                if (updateAxisReadbackPosition(status, pC_->getBatchReply(this->counterReplyIdx), readback_counter, &status)) {
+                    setDoubleParam(pC_->motorPosition_, readback_counter);
+                    if (this->restorePending) {
+                        restoreHomed(readback_counter);
+                    } else {
+                        persistCounter(readback_counter);
+                    }
+                    if (this->captureEnabled) {
+                        recordCapture(&pC_->batchTimes[this->counterReplyIdx], readback_counter);
+                    }
+                    if (this->listRunning) {
+                        advanceList(readback_counter);
+                    }
+                }
+            }
+        }
+    }
+
+    if (io_status != asynSuccess) { // A command sequence failed since last poll
+        status = io_status;
+    }
+    if (status != asynSuccess) {
+        invalidateSettings();
+        abortList();
+    }
+    setStatusProblem(status);
+
+    if ((this->listRunning) || (this->captureEnabled)) { // Keep the poller fast while dwelling or capturing
+        *moving = true;
+    }
+
+    return flushParams();
+}
+
+/** Tells whether the axis limits and readback must be queried in this poll cycle.
+  * Moving and just commanded axes are refreshed at every cycle, idle axes at the forced refresh period.
+  * Axes moving with a predicted end are refreshed at the idle poll period during the cruise phase,
+  * then at every cycle close to the predicted end and after it.
+  *
+  * \param[in] now Poll cycle timestamp
+  */
+bool OWISPSAxis::isPollDue(const epicsTimeStamp *now) {
+    if (this->axisType == UNKNOWN) {
+        return false;
+    }
+    if ((this->forceRefresh) || (this->listRunning) || (this->captureEnabled)) {
+        return true;
+    }
+    // Tolerate poller jitter, otherwise an axis could wait for two periods
+    if (isMovingStatus(this->axisStatus)) {
+        if ((this->expectedDuration < 0) ||
+            (epicsTimeDiffInSeconds(&this->expectedDone, now) <= (pC_->idlePollPeriod_ + OWISPS_DONE_MARGIN*this->expectedDuration))) {
+            return true;
+        }
+        return epicsTimeDiffInSeconds(now, &this->lastRefresh) >= (pC_->idlePollPeriod_ - pC_->movingPollPeriod_);
+    }
+    return epicsTimeDiffInSeconds(now, &this->lastRefresh) >= (pC_->forcedRefreshPeriod - pC_->movingPollPeriod_);
+}
+
+/** Appends the axis limits and readback queries to the controller poll batch.
+  *
+  * \param[in] now Poll cycle timestamp
+  */
+void OWISPSAxis::queuePollCommands(const epicsTimeStamp *now) {
+    if (this->axisType != UNKNOWN) {
+        this->limitsReplyIdx = pC_->queueBatchCommand(OWISPS_CMD_LIMSTAT, this->axisNo_);
+        this->counterReplyIdx = pC_->queueBatchCommand(OWISPS_CMD_GETCOUNTER, this->axisNo_);
+
+        this->lastRefresh = *now;
+    }
+}
+
+void OWISPSAxis::clearPollCommands(void) {
+    this->limitsReplyIdx = -1;
+    this->counterReplyIdx = -1;
+    this->typeReplyIdx = -1;
+    this->velocityReplyIdx = -1;
+}
+
+/** Tells whether the axis type must be queried in this poll cycle.
+  * Undiscovered axes are retried at the forced refresh period, so that missing axes do not weigh on every cycle.
+  *
+  * \param[in] now Poll cycle timestamp
+  */
+bool OWISPSAxis::isDiscoveryDue(const epicsTimeStamp *now) {
+    if (this->discovered) {
+        return false;
+    }
+    return (this->lastDiscovery.secPastEpoch == 0) ||
+           (epicsTimeDiffInSeconds(now, &this->lastDiscovery) >= (pC_->forcedRefreshPeriod - pC_->movingPollPeriod_));
+}
+
+/** Appends the axis type and velocity queries to the controller poll batch.
+  *
+  * \param[in] now Poll cycle timestamp
+  */
+void OWISPSAxis::queueDiscoveryCommands(const epicsTimeStamp *now) {
+    this->typeReplyIdx = pC_->queueBatchCommand(OWISPS_CMD_AXISTYPE, this->axisNo_);
+    this->velocityReplyIdx = pC_->queueBatchCommand(OWISPS_CMD_GETPOSVEL, this->axisNo_);
+    this->lastDiscovery = *now;
+}
+
+/** Parses the axis type and velocity replies of the controller poll batch.
+  * Once discovered, the axis limits and readback are queried in the same poll cycle, and its status processed.
+  *
+  * \param[in] now Poll cycle timestamp
+  *
+  * \return true if the axis was discovered
+  */
+bool OWISPSAxis::processDiscoveryReplies(const epicsTimeStamp *now) {
+    owispsAxisType axis_type;
+
+    if (!updateAxisType(pC_->getBatchStatus(this->typeReplyIdx), pC_->getBatchReply(this->typeReplyIdx), axis_type, NULL)) {
+        return false;
+    }
+
+    this->axisType = axis_type;
+    this->discovered = true;
+    invalidateSettings();
+    updateAxisVelocity(pC_->getBatchStatus(this->velocityReplyIdx), pC_->getBatchReply(this->velocityReplyIdx), this->positionVelocity, NULL);
+    this->forceRefresh = true;
+    setIntegerParam(pC_->motorStatusCommsError_, 0);
+
+    if (!isPollQueued()) {
+        queuePollCommands(now);
+    }
+    return true;
+}
+
+/** Flags the axis for discovery, after the controller stopped answering.
+  * The axis keeps its type meanwhile, and reports a communication error until discovered again.
+  *
+  */
+void OWISPSAxis::rediscover(void) {
+    if (this->discovered) {
+        this->discovered = false;
+        this->lastDiscovery.secPastEpoch = 0;
+        this->lastDiscovery.nsec = 0;
+    }
+    setIntegerParam(pC_->motorStatusCommsError_, 1);
+}
+
+/** Restores the axis configuration from the cache, until discovered.
+  * Discovery still runs: the type and velocity restored are only trusted until the controller answers.
+  *
+  * \param[in] entry Cached configuration
+  */
+void OWISPSAxis::restoreCache(const owispsCacheEntry *entry) {
+    if ((this->discovered) || (entry->type == UNKNOWN)) {
+        return;
+    }
+    this->axisType = static_cast<owispsAxisType>(entry->type);
+    this->homingType = entry->homingType;
+    this->positionVelocity = entry->velocity;
+    this->savedCounter = entry->counter;
+    this->savedHomed = entry->homed;
+    this->restorePending = restoreHomedFlags && (entry->homed >= 0);
+    setIntegerParam(pC_->motorStatusCommsError_, 0);
+}
+
+/** Saves the readback counter and homed flag in the cache, when the axis is idle and they changed.
+  *
+  * \param[in] readback Counter just polled
+  */
+void OWISPSAxis::persistCounter(long readback) {
+    int homed = 0;
+
+    if ((!pC_->cacheFile[0]) || (!(statusFlags(this->axisStatus) & OWISPS_STATUSFLAG_DONE))) {
+        return;
+    }
+    getIntegerParam(pC_->motorStatusHomed_, &homed);
+    homed = homed ? 1 : 0;
+    if ((readback != this->savedCounter) || (homed != this->savedHomed)) {
+        this->savedCounter = readback;
+        this->savedHomed = homed;
+        pC_->cacheDirty = true;
+    }
+}
+
+/** Restores the homed flag at startup, so that the axis need not be homed again.
+  * Only if the controller still has the saved counter: not if the axis was power-cycled meanwhile,
+  * as the stage may have moved unpowered, nor if the counter differs. The controller counter is never
+  * overwritten, the cache may be older than it.
+  *
+  * \param[in] readback First counter polled
+  */
+void OWISPSAxis::restoreHomed(long readback) {
+    static const char *functionName = "restoreHomed";
+
+    this->restorePending = false;
+    if ((this->axisStatus == OWISPS_STATUS_INITIALIZED) || (this->axisStatus == OWISPS_STATUS_UNKNOWN)) {
+        log(ASYN_TRACE_ERROR, "%s:%s: axis %d was power-cycled, homed flag not restored\n", driverName, functionName, this->axisNo_);
+        this->savedHomed = -1; // Saved again once idle, unhomed
+        return;
+    }
+    if (readback != this->savedCounter) {
+        log(ASYN_TRACE_ERROR, "%s:%s: axis %d counter %ld differs from saved %ld, kept, homed flag not restored\n", driverName, functionName, this->axisNo_, readback, this->savedCounter);
+        return;
+    }
+
+    if (this->savedHomed > 0) {
+        setIntegerParam(pC_->motorStatusHomed_, 1);
+    }
+}
+
+/** Publishes the last and worst-case STOP latency, in ms.
+  * Writing 0 to the worst-case parameter resets it.
+  *
+  * \param[in] latency Time taken to issue the STOP command, in seconds
+  */
+void OWISPSAxis::updateStopLatency(double latency) {
+    double max_latency = 0;
+
+    latency *= 1000.;
+    setDoubleParam(pC_->driverStopLatencyParam, latency);
+    getDoubleParam(pC_->driverStopLatencyMaxParam, &max_latency);
+    if (latency > max_latency) {
+        setDoubleParam(pC_->driverStopLatencyMaxParam, latency);
+    }
+}
+
+/** Starts stepping through the position list, from its first target.
+  *
+  * \return asynError if the list is empty or the first move fails
+  */
+asynStatus OWISPSAxis::startList(void) {
+    if ((this->listCount <= 0) || (this->listRunning)) {
+        return asynError;
+    }
+
+    this->listIndex = 0;
+    this->listArrived = false;
+    this->listRunning = true;
+    setIntegerParam(pC_->driverListRunParam, 1);
+    setIntegerParam(pC_->driverListIndexParam, 0);
+
+    if (startMove(this->listPositions[0], 0, 0, 0) != asynSuccess) {
+        abortList();
+        return asynError;
+    }
+    return asynSuccess;
 }
 
-/** Stops an ongoing motion.
+/** Stops stepping through the position list, the ongoing move (if any) is left alone.
   *
-  * \param[in] acceleration  Motion parameter
+  */
+void OWISPSAxis::abortList(void) {
+    if (this->listRunning) {
+        this->listRunning = false;
+        setIntegerParam(pC_->driverListRunParam, 0);
+    }
+}
+
+/** Records the readback of the current target once reached, then moves to the next target after the dwell time.
+  * Called for every processed poll reply while the position list is running.
   *
-  * \return Result of callParamCallbacks() call
+  * \param[in] readback Readback position, in counter steps
   */
-asynStatus OWISPSAxis::stop(double acceleration) {
-    asynStatus status = asynError;
+void OWISPSAxis::advanceList(double readback) {
+    epicsTimeStamp now;
+    double dwell = 0;
 
-    if (this->axisType != UNKNOWN) {
-        buildGenericCommand(pC_->outString_, OWISPS_STOP_CMD, this->axisNo_);
-        status = pC_->writeController();
+    if ((this->forceRefresh) || (this->deferredMove) || (isMovingStatus(this->axisStatus))) {
+        return; // Not there yet, or the status predates the move
     }
 
-    setStatusProblem(status);
+    epicsTimeGetCurrent(&now);
+    if (!this->listArrived) {
+        this->listReadbacks[this->listIndex] = readback;
+        this->listArrived = true;
+        this->listArrival = now;
+        pC_->doCallbacksFloat64Array(this->listReadbacks, this->listIndex+1, pC_->driverListReadbacksParam, this->axisNo_);
+    }
 
-    return callParamCallbacks();
+    getDoubleParam(pC_->driverListDwellParam, &dwell);
+    if (epicsTimeDiffInSeconds(&now, &this->listArrival) < dwell) {
+        return;
+    }
+
+    if (this->listIndex+1 >= this->listCount) {
+        abortList();
+        return;
+    }
+
+    this->listIndex++;
+    this->listArrived = false;
+    setIntegerParam(pC_->driverListIndexParam, this->listIndex);
+    if (startMove(this->listPositions[this->listIndex], 0, 0, 0) != asynSuccess) {
+        abortList();
+    }
 }
 
-/** Forces the axis readback position to some value.
+/** Enables the readback capture, discarding previous samples, or disables it keeping them for readout.
+  * The ring buffer is allocated when capture is first enabled, never on the poll path.
   *
-  * \param[in] position  The desired readback position
+  * \param[in] enable True to start a new capture
   *
-  * \return Result of callParamCallbacks() call
+  * \return asynError if the ring buffer cannot be allocated
   */
-asynStatus OWISPSAxis::setPosition(double position) {
-    asynStatus status = asynError;
+asynStatus OWISPSAxis::enableCapture(bool enable) {
+    if (enable) {
+        if (!this->captureTimes) {
+            this->captureTimes = (double*)calloc(MAX_OWISPS_CAPTURE_SIZE, sizeof(double));
+            this->capturePositions = (double*)calloc(MAX_OWISPS_CAPTURE_SIZE, sizeof(double));
+            this->captureStatus = (char*)calloc(MAX_OWISPS_CAPTURE_SIZE, sizeof(char));
+        }
+        if ((!this->captureTimes) || (!this->capturePositions) || (!this->captureStatus)) {
+            return asynError;
+        }
+        this->captureHead = 0;
+        this->captureCount = 0;
+        setIntegerParam(pC_->driverCaptureCountParam, 0);
+    }
 
-    buildSetPositionCommand(pC_->outString_, this->axisNo_, position);
-    status = pC_->writeController();
+    this->captureEnabled = enable;
+    setIntegerParam(pC_->driverCaptureParam, enable ? 1 : 0);
 
-    setStatusProblem(status);
+    return asynSuccess;
+}
 
-    return callParamCallbacks();
+/** Stores a sample in the capture ring buffer, overwriting the oldest one when full.
+  *
+  * \param[in] reply_time Time the readback reply was read
+  * \param[in] readback   Readback position, in counter steps
+  */
+void OWISPSAxis::recordCapture(const epicsTimeStamp *reply_time, long readback) {
+    this->captureTimes[this->captureHead] = reply_time->secPastEpoch + reply_time->nsec*1e-9;
+    this->capturePositions[this->captureHead] = readback;
+    this->captureStatus[this->captureHead] = this->axisStatus;
+
+    this->captureHead = (this->captureHead+1) % MAX_OWISPS_CAPTURE_SIZE;
+    if (this->captureCount < MAX_OWISPS_CAPTURE_SIZE) {
+        this->captureCount++;
+        setIntegerParam(pC_->driverCaptureCountParam, this->captureCount);
+    }
 }
 
-/** Polls the axis.
-  * Reads the limits state and readback position and calls setIntegerParam() or setDoubleParam() for each item that it polls.
+/** Copies the captured samples of one kind, oldest first.
   *
-  * \param[out] moving A flag that is set indicating that the axis is moving (1) or done (0).
+  * \param[in]  function    Parameter of the capture array
+  * \param[out] value       Array to fill, of doubles for times and positions, of chars for status
+  * \param[in]  max_samples Size of the array
   *
-  * \return Result of callParamCallbacks() call
+  * \return Number of samples copied
   */
-asynStatus OWISPSAxis::poll(bool *moving) { 
-    asynStatus status = asynError;
-    int at_limit, ismoving, lim_switches;
-    long readback_counter;
-
-    if (this->axisType != UNKNOWN) {
-
-        ismoving = ((this->axisStatus == OWISPS_STATUS_POSTRAP)    ||
-                    (this->axisStatus == OWISPS_STATUS_POSSCURVE)  ||
-                    (this->axisStatus == OWISPS_STATUS_HOMING)     ||
-                    (this->axisStatus == OWISPS_STATUS_RELEASW)    ||
-                    (this->axisStatus == OWISPS_STATUS_POSTRAPWMS) ||
-                    (this->axisStatus == OWISPS_STATUS_POSSCURVWMS)  );
-        *moving = ismoving;
+size_t OWISPSAxis::readCapture(int function, void *value, size_t max_samples) {
+    size_t count = this->captureCount;
+    int idx;
 
-        buildGenericCommand(pC_->outString_, OWISPS_LIMSTAT_CMD, this->axisNo_);
-        status = pC_->writeReadController();
-        if (updateAxisLimitsStatus(status, pC_->inString_, lim_switches, &status)) {
-            if (lim_switches & OWISPS_POWSTG_ERROR) { // Disconnected or power error?
-                status = asynError;
-
-            } else {
-                getIntegerParam(pC_->motorStatusLowLimit_, &at_limit);
-                if ( (lim_switches & OWISPS_LOWLIM_DEC) && (!at_limit)) {
-                    setIntegerParam(pC_->motorStatusLowLimit_, 1);
-                } else if ( !(lim_switches & OWISPS_LOWLIM_DEC) && (at_limit)) {
-                    setIntegerParam(pC_->motorStatusLowLimit_, 0);
-                }
-                getIntegerParam(pC_->motorStatusHighLimit_, &at_limit);
-                if ( (lim_switches & OWISPS_HIGHLIM_DEC) && (!at_limit)) {
-                    setIntegerParam(pC_->motorStatusHighLimit_, 1);
-                } else if ( !(lim_switches & OWISPS_HIGHLIM_DEC) && (at_limit)) {
-                    setIntegerParam(pC_->motorStatusHighLimit_, 0);
-                }
+    if (!this->captureTimes) {
+        return 0;
+    }
+    if (count > max_samples) {
+        count = max_samples;
+    }
 
-                buildGenericCommand(pC_->outString_, OWISPS_GETCOUNTER_CMD, this->axisNo_);
-                status = pC_->writeReadController();
-                if (updateAxisReadbackPosition(status, pC_->inString_, readback_counter, &status)) {
-                    setDoubleParam(pC_->motorPosition_, readback_counter);
-                }
-            }
+    for (size_t i=0; i<count; i++) {
+        idx = captureRingIndex(this->captureHead, this->captureCount, MAX_OWISPS_CAPTURE_SIZE, (int)i);
+        if (function == pC_->driverCaptureTimesParam) {
+            static_cast<double*>(value)[i] = this->captureTimes[idx];
+        } else if (function == pC_->driverCapturePositionsParam) {
+            static_cast<double*>(value)[i] = this->capturePositions[idx];
+        } else {
+            static_cast<char*>(value)[i] = this->captureStatus[idx];
         }
     }
 
-    setStatusProblem(status);
+    return count;
+}
 
-    return callParamCallbacks();
+/** Predicts when the move just started will be done, from the axis position velocity.
+  *
+  * \param[in] distance      Distance to travel, in counter steps
+  * \param[in] acceleration  Acceleration, in counter steps/s^2 (0 if unknown)
+  */
+void OWISPSAxis::predictMotionDone(double distance, double acceleration) {
+    this->expectedDuration = estimateMoveTime(distance, this->positionVelocity, acceleration);
+    if (this->expectedDuration >= 0) {
+        epicsTimeGetCurrent(&this->expectedDone);
+        epicsTimeAddSeconds(&this->expectedDone, this->expectedDuration);
+    }
+}
+
+/** Gives the ring buffer slot of a sample, 0 being the oldest.
+  *
+  * \param[in] head   Next slot to be written
+  * \param[in] count  Number of samples in the ring buffer
+  * \param[in] size   Size of the ring buffer
+  * \param[in] sample Sample number
+  */
+int OWISPSAxis::captureRingIndex(int head, int count, int size, int sample) {
+    return (head - count + sample + size) % size;
 }
 
 /** All the following methods parse a reply sent by the controller.
@@ -505,8 +3004,7 @@ asynStatus OWISPSAxis::poll(bool *moving) {
   */
 bool OWISPSAxis::updateAxisReadbackPosition(asynStatus status, const char *reply, long& readback, asynStatus *asyn_error) {
     bool res = false;
-    if ((status == asynSuccess) && (issigneddigit(reply))) {
-        readback = atol(reply);
+    if ((status == asynSuccess) && (parseInteger(reply, MAX_OWISPS_STRING_SIZE, readback))) {
         res = true;
     } else {
         if (asyn_error) *asyn_error = asynError;
@@ -516,8 +3014,9 @@ bool OWISPSAxis::updateAxisReadbackPosition(asynStatus status, const char *reply
 
 bool OWISPSAxis::updateAxisLimitsStatus(asynStatus status, const char *reply, int& lim_switches, asynStatus *asyn_error) {
     bool res = false;
-    if ((status == asynSuccess) && (strlen(reply)) && (isdigit(*reply))) {
-        lim_switches = atoi(reply);
+    long value = -1;
+    if ((status == asynSuccess) && (parseInteger(reply, MAX_OWISPS_STRING_SIZE, value)) && (value >= 0) && (value <= INT_MAX)) {
+        lim_switches = (int)value;
         res = true;
     } else {
         if (asyn_error) *asyn_error = asynError;
@@ -527,8 +3026,9 @@ bool OWISPSAxis::updateAxisLimitsStatus(asynStatus status, const char *reply, in
 
 bool OWISPSAxis::updateAxisType(asynStatus status, const char *reply, owispsAxisType& ax_type, asynStatus *asyn_error) {
     bool res = false;
-    if ((status == asynSuccess) && (strlen(reply)==1) && ((*reply>='0') && (*reply<='4'))) {
-        ax_type = static_cast<owispsAxisType>(atoi(reply));
+    long value = -1;
+    if ((status == asynSuccess) && (parseInteger(reply, MAX_OWISPS_STRING_SIZE, value) == 1) && (reply[1] == '\0') && (value >= 0) && (value <= 4)) {
+        ax_type = static_cast<owispsAxisType>(value);
         res = true;
     } else {
         if (asyn_error) *asyn_error = asynError;
@@ -536,99 +3036,139 @@ bool OWISPSAxis::updateAxisType(asynStatus status, const char *reply, owispsAxis
     return res;
 }
 
-/** The following methods generate a command string to be sent to the controller.
-  *
-  */
-bool OWISPSAxis::buildGenericCommand(char *buffer, const char *command_format, int axis) {
-    if ((!buffer) || (!command_format)) {
-        return false;
+bool OWISPSAxis::updateAxisVelocity(asynStatus status, const char *reply, int& velocity, asynStatus *asyn_error) {
+    bool res = false;
+    long value = -1;
+    if ((status == asynSuccess) && (parseInteger(reply, MAX_OWISPS_STRING_SIZE, value)) && (value >= 0) && (value <= INT_MAX)) {
+        velocity = (int)value;
+        res = true;
+    } else {
+        if (asyn_error) *asyn_error = asynError;
     }
-    sprintf(buffer, command_format, axis+1);
-    return true;
+    return res;
 }
 
-bool OWISPSAxis::buildMoveCommand(char *buffer, int axis, double position) {
+/** Parses a decimal integer, optionally negative, in a single pass: stops at the first non-digit, the end of the buffer or its NUL.
+  * Like std::from_chars, the value is left untouched on failure, and the length parsed tells where the rest of the reply starts.
+  *
+  * \param[in]  buffer  Reply
+  * \param[in]  size    Maximum number of characters to parse
+  * \param[out] value   Parsed integer
+  *
+  * \return Number of characters parsed, 0 if there are no digits or the integer overflows a long
+  */
+size_t OWISPSAxis::parseInteger(const char *buffer, size_t size, long& value) {
+    size_t i = 0, first_digit;
+    unsigned long magnitude = 0, limit = LONG_MAX;
+    bool negative = false;
+
     if (!buffer) {
-        return false;
+        return 0;
+    }
+    if ((size > 0) && (buffer[0] == '-')) {
+        negative = true;
+        limit = (unsigned long)LONG_MAX + 1;
+        i++;
     }
-    sprintf(buffer, OWISPS_POSSET_CMD, axis+1, (int)position);
-    return true;
-
-}
 
-bool OWISPSAxis::buildSetPositionCommand(char *buffer, int axis, double position) {
-    if (!buffer) {
-        return false;
+    for (first_digit=i; (i<size) && (buffer[i]>='0') && (buffer[i]<='9'); i++) {
+        unsigned long digit = buffer[i]-'0';
+        if (magnitude > (limit-digit)/10) {
+            return 0;
+        }
+        magnitude = magnitude*10 + digit;
+    }
+    if (i == first_digit) {
+        return 0;
     }
-    sprintf(buffer, OWISPS_SETCOUNTER_CMD, axis+1, (int)position);
-    return true;
 
+    value = negative ? -(long)(magnitude-1) - 1 : (long)magnitude;
+    return i;
 }
 
-bool OWISPSAxis::buildHomeCommand(char *buffer, int axis, int home_type) {
-    if (!buffer) {
-        return false;
+/** Estimates the duration of a trapezoidal (or triangular, for short distances) move profile.
+  *
+  * \param[in] distance      Distance to travel
+  * \param[in] velocity      Cruise velocity
+  * \param[in] acceleration  Acceleration, ignored if not positive
+  *
+  * \return Duration in seconds, -1 if the velocity is unknown
+  */
+double OWISPSAxis::estimateMoveTime(double distance, double velocity, double acceleration) {
+    if (velocity <= 0) {
+        return -1;
+    }
+    distance = fabs(distance);
+    if (acceleration <= 0) {
+        return distance/velocity;
     }
+    if (distance >= velocity*velocity/acceleration) {
+        return distance/velocity + velocity/acceleration;
+    }
+    return 2*sqrt(distance/acceleration);
+}
 
-    sprintf(buffer, OWISPS_HOME_CMD, axis+1, home_type);
-    return true;
+/** Tells whether an axis status character means the axis is in motion.
+  *
+  */
+bool OWISPSAxis::isMovingStatus(char owisps_status) {
+    return (statusFlagTable[(unsigned char)owisps_status] & OWISPS_STATUSFLAG_MOVING) != 0;
+}
+
+/** Gives the OWISPS_STATUSFLAG_* flags of an axis status character.
+  *
+  */
+epicsUInt8 OWISPSAxis::statusFlags(char owisps_status) {
+    return statusFlagTable[(unsigned char)owisps_status];
 }
 
 /** Updates the axis status. Calls setIntegerParam() for moving, done, home, homed.
+  * The status character is decoded with statusFlagTable, characters without flags only update axisStatus.
   *
   * \param[in] owisps_status Axis status, from controller
   */
 void OWISPSAxis::updateAxisStatus(char owisps_status) {
     int status_done=1, status_home=0, status_moving=0;
+    epicsUInt8 flags = statusFlags(owisps_status);
 
     if (this->axisType != UNKNOWN) {
 
         this->axisStatus = owisps_status;
 
-        switch(owisps_status) {
-            case OWISPS_STATUS_UNKNOWN:
-                setStatusProblem(asynError);
-                break;
+        if (flags & OWISPS_STATUSFLAG_PROBLEM) {
+            setStatusProblem(asynError);
 
-            case OWISPS_STATUS_READY:
-                setStatusProblem(asynSuccess);
+        } else if (flags & OWISPS_STATUSFLAG_DONE) {
+            setStatusProblem(asynSuccess);
 
-                getIntegerParam(pC_->motorStatusMoving_, &status_moving);
-                if (status_moving) {
-                    this->setIntegerParam(pC_->motorStatusMoving_, 0);
-                }
+            getIntegerParam(pC_->motorStatusMoving_, &status_moving);
+            if (status_moving) {
+                this->setIntegerParam(pC_->motorStatusMoving_, 0);
+            }
 
-                getIntegerParam(pC_->motorStatusDone_, &status_done);
-                if (!status_done) {
-                    setIntegerParam(pC_->motorStatusDone_, 1);
-                    executePost();
-                }
+            getIntegerParam(pC_->motorStatusDone_, &status_done);
+            if (!status_done) {
+                setIntegerParam(pC_->motorStatusDone_, 1);
+                executePost();
+            }
 
-                getIntegerParam(pC_->motorStatusHome_, &status_home);
-                if (status_home) {
-                    setIntegerParam(pC_->motorStatusHome_, 0);
-                    setIntegerParam(pC_->motorStatusHomed_, 1);
-                }
-                break;
+            getIntegerParam(pC_->motorStatusHome_, &status_home);
+            if (status_home) {
+                setIntegerParam(pC_->motorStatusHome_, 0);
+                setIntegerParam(pC_->motorStatusHomed_, 1);
+            }
 
-            case OWISPS_STATUS_POSTRAP:
-            case OWISPS_STATUS_POSSCURVE:
-            case OWISPS_STATUS_HOMING:
-            case OWISPS_STATUS_RELEASW:
-            case OWISPS_STATUS_POSTRAPWMS:
-            case OWISPS_STATUS_POSSCURVWMS:
-                setStatusProblem(asynSuccess);
-
-                getIntegerParam(pC_->motorStatusMoving_, &status_moving);
-                if (!status_moving) {
-                    setIntegerParam(pC_->motorStatusMoving_, 1);
-                }
-                getIntegerParam(pC_->motorStatusDone_, &status_done);
-                if (status_done) {
-                    setIntegerParam(pC_->motorStatusDone_, 0);
-                }
-                break;
-            
+        } else if (flags & OWISPS_STATUSFLAG_MOVING) {
+            setStatusProblem(asynSuccess);
+
+            getIntegerParam(pC_->motorStatusMoving_, &status_moving);
+            if (!status_moving) {
+                setIntegerParam(pC_->motorStatusMoving_, 1);
+            }
+            getIntegerParam(pC_->motorStatusDone_, &status_done);
+            if (status_done) {
+                setIntegerParam(pC_->motorStatusDone_, 0);
+            }
         }
     }
 }
@@ -638,21 +3178,13 @@ void OWISPSAxis::updateAxisStatus(char owisps_status) {
   * \param[in] status Last operation status
   */
 void OWISPSAxis::setStatusProblem(asynStatus status) {
-    int status_problem;
-
-    getIntegerParam(pC_->motorStatus_, &status_problem);
-    if ((status != asynSuccess) && (!status_problem)) {
-        setIntegerParam(pC_->motorStatusProblem_, 1);
-    }
-    if ((status == asynSuccess) && (status_problem)) {
-        setIntegerParam(pC_->motorStatusProblem_, 0);
-    }
+    setIntegerParam(pC_->motorStatusProblem_, (status != asynSuccess) ? 1 : 0);
 }
 
 
 /** Initializes the axis, if motor record INIT field equals to "INIT".
   *
-  * \return Result of either getStringParam() or writeController() calls
+  * \return Result of either getStringParam() or sendSequence() calls
   */
 asynStatus OWISPSAxis::executeInit(void) {
     asynStatus status = asynError;
@@ -661,8 +3193,12 @@ asynStatus OWISPSAxis::executeInit(void) {
     if (getStringParam(pC_->driverInitParam, (int)sizeof(init), init) == asynSuccess) {
         if (strlen(init)) {
             if (!strcmp(init, AXIS_INIT_VALUEINIT)) {
-                buildGenericCommand(pC_->outString_, OWISPS_INIT_CMD, this->axisNo_);
-                status = pC_->writeController();
+                invalidateSettings();
+                beginSequence();
+                status = appendSequence(OWISPS_CMD_INIT);
+                if (status == asynSuccess) {
+                    status = sendSequence();
+                }
             }
 
             setStatusProblem(status);
@@ -673,8 +3209,9 @@ asynStatus OWISPSAxis::executeInit(void) {
 }
 
 /** Initializes or enables the axis, if motor record PREM field equals to "INIT" or "MON".
+  * The command is appended to the sequence being built, the caller sends it.
   *
-  * \return Result of either getStringParam() or writeController() calls
+  * \return Result of either getStringParam() or appendSequence() calls
   */
 asynStatus OWISPSAxis::executePrem(void) {
     asynStatus status = asynError;
@@ -683,11 +3220,10 @@ asynStatus OWISPSAxis::executePrem(void) {
     if (getStringParam(pC_->driverPremParam, (int)sizeof(prem), prem) == asynSuccess) {
         if (strlen(prem)) {
             if (!strcmp(prem, AXIS_PREM_VALUEINIT)) {
-                buildGenericCommand(pC_->outString_, OWISPS_INIT_CMD, this->axisNo_);
-                status = pC_->writeController();
+                invalidateSettings();
+                status = appendSequence(OWISPS_CMD_INIT);
             } else if (!strcmp(prem, AXIS_PREM_VALUEON)) {
-                buildGenericCommand(pC_->outString_, OWISPS_MON_CMD, this->axisNo_);
-                status = pC_->writeController();
+                status = appendSequence(OWISPS_CMD_MON);
             }
 
             setStatusProblem(status);
@@ -699,7 +3235,7 @@ asynStatus OWISPSAxis::executePrem(void) {
 
 /** Disables the axis, if motor record POST field equals to "MOFF".
   *
-  * \return Result of either getStringParam() or writeController() calls
+  * \return Result of either getStringParam() or sendSequence() calls
   */
 asynStatus OWISPSAxis::executePost(void) {
     asynStatus status = asynError;
@@ -708,8 +3244,11 @@ asynStatus OWISPSAxis::executePost(void) {
     if (getStringParam(pC_->driverPostParam, (int)sizeof(post), post) == asynSuccess) {
         if (strlen(post)) {
             if (!strcmp(post, AXIS_POST_VALUEOFF)) {
-                buildGenericCommand(pC_->outString_, OWISPS_MOFF_CMD, this->axisNo_);
-                status = pC_->writeController();
+                beginSequence();
+                status = appendSequence(OWISPS_CMD_MOFF);
+                if (status == asynSuccess) {
+                    status = sendSequence();
+                }
             }
 
             setStatusProblem(status);
@@ -719,6 +3258,90 @@ asynStatus OWISPSAxis::executePost(void) {
     return status;
 }
 
+/** Build the command sequence of an axis operation, to be written in one go by the controller I/O thread.
+  *
+  */
+void OWISPSAxis::beginSequence(void) {
+    this->sequence[0] = '\0';
+    this->sequenceLength = 0;
+}
+
+/** Appends a command of this axis, formatted in place; queries are refused, as sequences are written without reading back.
+  *
+  * \param[in] command Command to be appended
+  * \param[in] value   Value, for the commands taking one
+  */
+asynStatus OWISPSAxis::appendSequence(owispsCommandId command, long value) {
+    const owispsCommandDescriptor *descriptor = OWISPSController::commandDescriptor(command);
+    size_t length;
+
+    if ((!descriptor) || (descriptor->reply != OWISPS_REPLY_NONE)) {
+        return asynError;
+    }
+    length = OWISPSController::appendCommand(this->sequence, sizeof(this->sequence), this->sequenceLength, command, this->axisNo_, value);
+    if (!length) {
+        return asynError;
+    }
+    this->sequenceLength = length;
+    return asynSuccess;
+}
+
+asynStatus OWISPSAxis::sendSequence(void) {
+    if (!this->sequenceLength) {
+        return asynSuccess;
+    }
+    return pC_->queueController(this, this->sequence);
+}
+
+/** Appends ABSOL or RELAT to the sequence being built, unless the axis is known to be in that mode already.
+  *
+  * \param[in] relative OWISPS_COORD_RELATIVE or OWISPS_COORD_ABSOLUTE
+  *
+  * \return Result of appendSequence() call
+  */
+asynStatus OWISPSAxis::appendCoordinateMode(int relative) {
+    asynStatus status = asynSuccess;
+
+    if (this->coordinateMode != relative) {
+        status = appendSequence((relative == OWISPS_COORD_RELATIVE) ? OWISPS_CMD_RELCOORD : OWISPS_CMD_ABSCOORD);
+        this->coordinateMode = (status == asynSuccess) ? relative : OWISPS_COORD_UNKNOWN;
+    }
+
+    return status;
+}
+
+/** Appends PVEL and ACC to the sequence being built, for the values that are positive and differ from the last ones sent.
+  *
+  * \param[in] velocity      Positioning velocity, in counter steps/s
+  * \param[in] acceleration  Acceleration, in counter steps/s^2
+  *
+  * \return Result of appendSequence() calls
+  */
+asynStatus OWISPSAxis::appendVelocity(double velocity, double acceleration) {
+    asynStatus status = asynSuccess;
+
+    if (((int)velocity > 0) && ((int)velocity != this->positionVelocity)) {
+        status = appendSequence(OWISPS_CMD_SETPOSVEL, (long)velocity);
+        this->positionVelocity = (status == asynSuccess) ? (int)velocity : 0;
+    }
+
+    if ((status == asynSuccess) && ((int)acceleration > 0) && ((int)acceleration != this->positionAcceleration)) {
+        status = appendSequence(OWISPS_CMD_SETACC, (long)acceleration);
+        this->positionAcceleration = (status == asynSuccess) ? (int)acceleration : 0;
+    }
+
+    return status;
+}
+
+/** Forgets the cached controller settings, so that they are sent again with the next command.
+  *
+  */
+void OWISPSAxis::invalidateSettings(void) {
+    this->coordinateMode = OWISPS_COORD_UNKNOWN;
+    this->positionVelocity = 0;
+    this->positionAcceleration = 0;
+}
+
 /** Shortcuts to asynMotorController functions.
   *
   */
@@ -726,10 +3349,63 @@ asynStatus OWISPSAxis::getIntegerParam(int index, epicsInt32 *value) {
     return this->pC_->getIntegerParam(this->axisNo_, index, value);
 }
 
+asynStatus OWISPSAxis::getDoubleParam(int index, double *value) {
+    return this->pC_->getDoubleParam(this->axisNo_, index, value);
+}
+
 asynStatus OWISPSAxis::getStringParam(int index, int max_chars, char *value) {
     return this->pC_->getStringParam(this->axisNo_, index, max_chars, value);
 }
 
+/** Sets an integer parameter, unless it already holds that value.
+  *
+  * \return asynSuccess if unchanged, result of asynMotorAxis::setIntegerParam() call otherwise
+  */
+asynStatus OWISPSAxis::setIntegerParam(int index, int value) {
+    epicsInt32 current;
+
+    if ((this->pC_->getIntegerParam(this->axisNo_, index, &current) == asynSuccess) && (current == value)) {
+        return asynSuccess;
+    }
+    this->paramsChanged = true;
+    return asynMotorAxis::setIntegerParam(index, value);
+}
+
+/** Sets a double parameter, unless it already holds that value.
+  *
+  * \return asynSuccess if unchanged, result of asynMotorAxis::setDoubleParam() call otherwise
+  */
+asynStatus OWISPSAxis::setDoubleParam(int index, double value) {
+    double current;
+
+    if ((this->pC_->getDoubleParam(this->axisNo_, index, &current) == asynSuccess) && (current == value)) {
+        return asynSuccess;
+    }
+    this->paramsChanged = true;
+    return asynMotorAxis::setDoubleParam(index, value);
+}
+
+/** Posts the changed parameters, also called by asynMotorController after the writes it handles.
+  *
+  */
+asynStatus OWISPSAxis::callParamCallbacks(void) {
+    this->paramsChanged = false;
+    return asynMotorAxis::callParamCallbacks();
+}
+
+/** Posts the parameters if any was changed since the last callbacks.
+  * Called once per poll cycle, so moves, stops and status changes of the cycle reach the records together.
+  *
+  * \return asynSuccess if nothing changed, result of callParamCallbacks() call otherwise
+  */
+asynStatus OWISPSAxis::flushParams(void) {
+    if (!this->paramsChanged) {
+        return asynSuccess;
+    }
+    this->paramsChanged = false;
+    return callParamCallbacks();
+}
+
 /** Provide a class method to be used instead of asynPrint().
   * Beware: can be called from constructor!
   */
@@ -776,8 +3452,204 @@ static void OWISPSCreateControllerCallFunc(const iocshArgBuf *args) {
     OWISPSCreateController(args[0].sval, args[1].sval, args[2].ival, args[3].ival, args[4].ival);
 }
 
+/** Configures the refresh of idle axes of an existing OWISPSController object.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName             The name of the asyn port of the OWISPSController
+  * \param[in] forcedRefreshPeriod  The time in ms after which idle axes are refreshed even if their status did not change
+  *
+  * \return asynError if the controller does not exist, asynSuccess otherwise
+  */
+extern "C" int OWISPSConfigRefresh(const char *portName, int forcedRefreshPeriod) {
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    if (!pC) {
+        printf("%s:OWISPSConfigRefresh: cannot find OWIS PS controller %s\n", driverName, portName);
+        return asynError;
+    }
+    pC->setForcedRefreshPeriod(forcedRefreshPeriod/1000.);
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSConfigRefreshArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSConfigRefreshArg1 = { "Forced refresh period (ms)", iocshArgInt };
+static const iocshArg * const OWISPSConfigRefreshArgs[] = { &OWISPSConfigRefreshArg0,
+                                                            &OWISPSConfigRefreshArg1 };
+static const iocshFuncDef OWISPSConfigRefreshDef = { "OWISPSConfigRefresh", 2, OWISPSConfigRefreshArgs };
+static void OWISPSConfigRefreshCallFunc(const iocshArgBuf *args) {
+    OWISPSConfigRefresh(args[0].sval, args[1].ival);
+}
+
+/** Enables the axes configuration cache of the OWISPSController objects created afterwards.
+  * Configuration command, called directly or from iocsh, before OWISPSCreateController
+  *
+  * \param[in] directory        The directory of the cache files, one per controller port
+  * \param[in] restoreHomed     1 to restore the homed flags at startup, on axes whose counter is unchanged
+  */
+extern "C" int OWISPSConfigCache(const char *directory, int restoreHomed) {
+    OWISPSController::setCacheDirectory(directory, restoreHomed != 0);
+    return asynSuccess;
+}
+
+/** Makes the OWISPSController objects created afterwards polled by the replay and benchmark drivers only.
+  * Configuration command, called directly or from iocsh, before OWISPSCreateController
+  *
+  * \param[in] manual  1 for no poller, 0 to restore the default
+  */
+extern "C" int OWISPSConfigManualPolling(int manual) {
+    OWISPSController::setManualPolling(manual != 0);
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSConfigManualPollingArg0 = { "Manual polling", iocshArgInt };
+static const iocshArg * const OWISPSConfigManualPollingArgs[] = { &OWISPSConfigManualPollingArg0 };
+static const iocshFuncDef OWISPSConfigManualPollingDef = { "OWISPSConfigManualPolling", 1, OWISPSConfigManualPollingArgs };
+static void OWISPSConfigManualPollingCallFunc(const iocshArgBuf *args) {
+    OWISPSConfigManualPolling(args[0].ival);
+}
+
+static const iocshArg OWISPSConfigCacheArg0 = { "Directory", iocshArgString };
+static const iocshArg OWISPSConfigCacheArg1 = { "Restore homed", iocshArgInt };
+static const iocshArg * const OWISPSConfigCacheArgs[] = { &OWISPSConfigCacheArg0,
+                                                          &OWISPSConfigCacheArg1 };
+static const iocshFuncDef OWISPSConfigCacheDef = { "OWISPSConfigCache", 2, OWISPSConfigCacheArgs };
+static void OWISPSConfigCacheCallFunc(const iocshArgBuf *args) {
+    OWISPSConfigCache(args[0].sval, args[1].ival);
+}
+
+/** Enables profile moves on an existing OWISPSController object.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName   The name of the asyn port of the OWISPSController
+  * \param[in] maxPoints  The maximum number of profile points
+  *
+  * \return asynError if the controller does not exist, result of initializeProfile() otherwise
+  */
+extern "C" int OWISPSCreateProfile(const char *portName, int maxPoints) {
+    asynStatus status;
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    if (!pC) {
+        printf("%s:OWISPSCreateProfile: cannot find OWIS PS controller %s\n", driverName, portName);
+        return asynError;
+    }
+    pC->lock();
+    status = pC->initializeProfile(maxPoints);
+    pC->unlock();
+    return status;
+}
+
+static const iocshArg OWISPSCreateProfileArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSCreateProfileArg1 = { "Max points", iocshArgInt };
+static const iocshArg * const OWISPSCreateProfileArgs[] = { &OWISPSCreateProfileArg0,
+                                                            &OWISPSCreateProfileArg1 };
+static const iocshFuncDef OWISPSCreateProfileDef = { "OWISPSCreateProfile", 2, OWISPSCreateProfileArgs };
+static void OWISPSCreateProfileCallFunc(const iocshArgBuf *args) {
+    OWISPSCreateProfile(args[0].sval, args[1].ival);
+}
+
+/** Dumps the serial traffic trace of an existing OWISPSController object.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName  The name of the asyn port of the OWISPSController
+  * \param[in] count     The number of most recent entries, 0 for all
+  * \param[in] fileName  The file to write to, standard output if empty
+  *
+  * \return asynError if the controller does not exist or the file cannot be opened
+  */
+extern "C" int OWISPSTraceDump(const char *portName, int count, const char *fileName) {
+    FILE *fp = stdout;
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    if (!pC) {
+        printf("%s:OWISPSTraceDump: cannot find OWIS PS controller %s\n", driverName, portName);
+        return asynError;
+    }
+    if ((fileName) && (*fileName)) {
+        fp = fopen(fileName, "w");
+        if (!fp) {
+            printf("%s:OWISPSTraceDump: cannot open %s\n", driverName, fileName);
+            return asynError;
+        }
+    }
+    pC->dumpTrace(fp, count);
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSTraceDumpArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSTraceDumpArg1 = { "Count", iocshArgInt };
+static const iocshArg OWISPSTraceDumpArg2 = { "File name", iocshArgString };
+static const iocshArg * const OWISPSTraceDumpArgs[] = { &OWISPSTraceDumpArg0,
+                                                        &OWISPSTraceDumpArg1,
+                                                        &OWISPSTraceDumpArg2 };
+static const iocshFuncDef OWISPSTraceDumpDef = { "OWISPSTraceDump", 3, OWISPSTraceDumpArgs };
+static void OWISPSTraceDumpCallFunc(const iocshArgBuf *args) {
+    OWISPSTraceDump(args[0].sval, args[1].ival, args[2].sval);
+}
+
+/** Starts recording a transcript of the serial traffic of an existing OWISPSController object, for OWISPSCreateReplay.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName  The name of the asyn port of the OWISPSController
+  * \param[in] fileName  The transcript file
+  *
+  * \return asynError if the controller does not exist or the file cannot be created
+  */
+extern "C" int OWISPSRecordStart(const char *portName, const char *fileName) {
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    if (!pC) {
+        printf("%s:OWISPSRecordStart: cannot find OWIS PS controller %s\n", driverName, portName);
+        return asynError;
+    }
+    if ((!fileName) || (pC->startRecording(fileName) != asynSuccess)) {
+        printf("%s:OWISPSRecordStart: cannot create %s\n", driverName, fileName ? fileName : "");
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSRecordStartArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSRecordStartArg1 = { "File name", iocshArgString };
+static const iocshArg * const OWISPSRecordStartArgs[] = { &OWISPSRecordStartArg0,
+                                                          &OWISPSRecordStartArg1 };
+static const iocshFuncDef OWISPSRecordStartDef = { "OWISPSRecordStart", 2, OWISPSRecordStartArgs };
+static void OWISPSRecordStartCallFunc(const iocshArgBuf *args) {
+    OWISPSRecordStart(args[0].sval, args[1].sval);
+}
+
+/** Stops recording the transcript started with OWISPSRecordStart.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName  The name of the asyn port of the OWISPSController
+  *
+  * \return asynError if the controller does not exist
+  */
+extern "C" int OWISPSRecordStop(const char *portName) {
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    if (!pC) {
+        printf("%s:OWISPSRecordStop: cannot find OWIS PS controller %s\n", driverName, portName);
+        return asynError;
+    }
+    pC->stopRecording();
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSRecordStopArg0 = { "Port name", iocshArgString };
+static const iocshArg * const OWISPSRecordStopArgs[] = { &OWISPSRecordStopArg0 };
+static const iocshFuncDef OWISPSRecordStopDef = { "OWISPSRecordStop", 1, OWISPSRecordStopArgs };
+static void OWISPSRecordStopCallFunc(const iocshArgBuf *args) {
+    OWISPSRecordStop(args[0].sval);
+}
+
 static void OWISPSControllerRegister(void) {
     iocshRegister(&OWISPSCreateControllerDef, OWISPSCreateControllerCallFunc);
+    iocshRegister(&OWISPSConfigRefreshDef, OWISPSConfigRefreshCallFunc);
+    iocshRegister(&OWISPSConfigCacheDef, OWISPSConfigCacheCallFunc);
+    iocshRegister(&OWISPSConfigManualPollingDef, OWISPSConfigManualPollingCallFunc);
+    iocshRegister(&OWISPSCreateProfileDef, OWISPSCreateProfileCallFunc);
+    iocshRegister(&OWISPSTraceDumpDef, OWISPSTraceDumpCallFunc);
+    iocshRegister(&OWISPSRecordStartDef, OWISPSRecordStartCallFunc);
+    iocshRegister(&OWISPSRecordStopDef, OWISPSRecordStopCallFunc);
 }
 
 extern "C" {
@@ -12,10 +12,58 @@ September 2020
 #include <asynMotorController.h>
 #include <asynMotorAxis.h>
 
+#include <epicsTime.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsMessageQueue.h>
+#include <asynOctet.h>
+
 
 
 #define MAX_OWISPS_STRING_SIZE 80
 
+#define OWISPS_DONE_MARGIN 0.1 // Fraction of the expected move time polled densely before the predicted end
+
+#define OWISPS_PROFILE_POINT_TIMEOUT 300. // Maximum time for all profile axes to reach a point, in seconds
+
+#define MAX_OWISPS_BATCH_SIZE        32 // Enough for ?ASTAT plus ?ESTAT and ?CNT of a 9-axis PS90
+#define MAX_OWISPS_BATCH_STRING_SIZE (MAX_OWISPS_BATCH_SIZE*MAX_OWISPS_STRING_SIZE)
+
+#define OWISPS_BATCH_SEPARATOR "\r"
+
+#define MAX_OWISPS_LIST_SIZE 1000 // Points of an axis position list
+
+#define MAX_OWISPS_CAPTURE_SIZE 10000 // Samples of the readback capture ring buffer of an axis
+
+#define OWISPS_LATENCY_BUCKETS 24 // Log2 buckets of microseconds, up to 16 s
+#define OWISPS_STATS_PERIOD    1. // Period at which link statistics are published, in seconds
+
+#define OWISPS_PROBE_MIN_PERIOD 0.5 // First interval between probes of a controller not answering, in seconds
+#define OWISPS_PROBE_MAX_PERIOD 30. // Bound of the interval, doubled at each failed probe
+
+#define OWISPS_TRACE_SIZE      4096 // Entries of the serial traffic trace
+#define OWISPS_TRACE_TEXT_SIZE 48   // Characters of a command or reply kept in the trace
+
+#define OWISPS_TRACE_WRITE    'W' // Command sequence written
+#define OWISPS_TRACE_QUERY    'Q' // Command of a pipelined transaction
+#define OWISPS_TRACE_REPLY    'R' // Reply read
+#define OWISPS_TRACE_PRIORITY 'P' // Command written through the priority lane
+#define OWISPS_TRACE_CYCLE    'C' // Poll cycle started, transcripts only
+#define OWISPS_TRACE_MOVE     'M' // Move started (axis position relative velocity acceleration), transcripts only
+#define OWISPS_TRACE_HOME     'H' // Homing started (axis acceleration), transcripts only
+
+#define OWISPS_TRANSCRIPT_HEADER "# OWISPS transcript" // Followed by the port name and number of axes
+
+#define OWISPS_CACHE_HEADER    "# OWISPS cache" // Followed by the port name and number of axes
+#define OWISPS_CACHE_VERSION   "version"        // Followed by the ?VERSION reply the cache was taken with
+#define OWISPS_CACHE_AXIS      "axis"           // Followed by axis number, type, homing type, velocity, counter and homed flag
+#define OWISPS_CACHE_EXTENSION ".cache"
+#define OWISPS_CACHE_PERIOD    1.               // Minimum seconds between two writes of the cache file
+#define MAX_OWISPS_PATH_SIZE   256
+
+#define MAX_OWISPS_SEQUENCE_SIZE 200 // Command sequence of one axis operation, e.g. MON, ABSOL, PSET, PGO
+#define OWISPS_IO_QUEUE_SIZE     64
+
 #define AXIS_INIT_PARAMNAME "MOTOR_INIT"
 #define AXIS_INIT_VALUEINIT "INIT"
 
@@ -26,6 +74,31 @@ September 2020
 #define AXIS_POST_PARAMNAME "MOTOR_POST"
 #define AXIS_POST_VALUEOFF  "MOFF"
 
+#define AXIS_STOPLATENCY_PARAMNAME    "MOTOR_STOP_LATENCY"
+#define AXIS_STOPLATENCYMAX_PARAMNAME "MOTOR_STOP_LATENCY_MAX"
+
+#define AXIS_LISTPOSITIONS_PARAMNAME "MOTOR_LIST_POSITIONS"
+#define AXIS_LISTDWELL_PARAMNAME     "MOTOR_LIST_DWELL"
+#define AXIS_LISTRUN_PARAMNAME       "MOTOR_LIST_RUN"
+#define AXIS_LISTINDEX_PARAMNAME     "MOTOR_LIST_INDEX"
+#define AXIS_LISTREADBACKS_PARAMNAME "MOTOR_LIST_READBACKS"
+
+#define AXIS_CAPTURE_PARAMNAME          "MOTOR_CAPTURE"
+#define AXIS_CAPTURECOUNT_PARAMNAME     "MOTOR_CAPTURE_COUNT"
+#define AXIS_CAPTURETIMES_PARAMNAME     "MOTOR_CAPTURE_TIMES"
+#define AXIS_CAPTUREPOSITIONS_PARAMNAME "MOTOR_CAPTURE_POSITIONS"
+#define AXIS_CAPTURESTATUS_PARAMNAME    "MOTOR_CAPTURE_STATUS"
+
+#define CTRL_LATENCYMIN_PARAMNAME   "OWISPS_LATENCY_MIN_%s"
+#define CTRL_LATENCYMEAN_PARAMNAME  "OWISPS_LATENCY_MEAN_%s"
+#define CTRL_LATENCYP99_PARAMNAME   "OWISPS_LATENCY_P99_%s"
+#define CTRL_LATENCYCOUNT_PARAMNAME "OWISPS_LATENCY_COUNT_%s"
+#define CTRL_TRANSACTIONRATE_PARAMNAME "OWISPS_TRANSACTION_RATE"
+#define CTRL_BYTERATE_PARAMNAME        "OWISPS_BYTE_RATE"
+#define CTRL_TIMEOUTS_PARAMNAME        "OWISPS_TIMEOUTS"
+#define CTRL_POLLCYCLE_PARAMNAME       "OWISPS_POLL_CYCLE"
+#define CTRL_STATSRESET_PARAMNAME      "OWISPS_STATS_RESET"
+
 
 
 #define OWISPS_STATUS_INITIALIZED 'I'
@@ -51,6 +124,11 @@ September 2020
 #define OWISPS_STATUS_PIEZOWMS    'N'
 #define OWISPS_STATUS_UNKNOWN     '?'
 
+#define OWISPS_STATUSFLAG_MOVING  0x01 // Motion in progress
+#define OWISPS_STATUSFLAG_DONE    0x02 // Ready, motion done
+#define OWISPS_STATUSFLAG_PROBLEM 0x04 // Axis status not known
+#define OWISPS_STATUSFLAG_HOMING  0x08 // Reference motion in progress
+
 #define OWISPS_REF_IDX       0
 #define OWISPS_REF_REFSW     1
 #define OWISPS_REF_REFSWIDX  2
@@ -66,34 +144,120 @@ September 2020
 #define OWISPS_HIGHLIM_STOP 8
 #define OWISPS_POWSTG_ERROR 16
 
-#define OWISPS_AXISTYPE_CMD "?MOTYPE%d"
+#define OWISPS_COORD_UNKNOWN  -1
+#define OWISPS_COORD_ABSOLUTE 0
+#define OWISPS_COORD_RELATIVE 1
 
-#define OWISPS_AXESSTAT_CMD "?ASTAT"
-#define OWISPS_LIMSTAT_CMD  "?ESTAT%d"
 
-#define OWISPS_INIT_CMD "INIT%d"
-#define OWISPS_MOFF_CMD "MOFF%d"
-#define OWISPS_MON_CMD  "MON%d"
-#define OWISPS_STOP_CMD "STOP%d"
 
-#define OWISPS_GETCOUNTER_CMD "?CNT%d"
-#define OWISPS_SETCOUNTER_CMD "CNT%d=%d"
+enum owispsIoType {
+    OWISPS_IO_WRITE, // Write a command sequence on behalf of an axis
+    OWISPS_IO_BATCH, // Transfer the controller poll batch
+    OWISPS_IO_POLL,  // Transfer the controller poll batch, then hand the controller back to the shared poller
+    OWISPS_IO_EXIT   // Stop the I/O thread, once the requests queued before are served
+};
 
-#define OWISPS_GETPOSVEL_CMD "?PVEL%d"
-#define OWISPS_SETPOSVEL_CMD "PVEL%d=%d"
+enum owispsPollPhase {
+    OWISPS_POLL_IDLE,    // Between poll cycles
+    OWISPS_POLL_STATUS,  // ?ASTAT and due axes queries on the wire
+    OWISPS_POLL_CHANGED  // Queries of the axes whose status changed on the wire
+};
 
-#define OWISPS_ABSCOORD_CMD "ABSOL%d"
-#define OWISPS_RELCOORD_CMD "RELAT%d"
+enum owispsCommandType {
+    OWISPS_CMDTYPE_ASTAT,
+    OWISPS_CMDTYPE_ESTAT,
+    OWISPS_CMDTYPE_CNT,
+    OWISPS_CMDTYPE_MOVE, // PSET, PGO
+    OWISPS_CMDTYPE_HOME, // REF
+    OWISPS_CMDTYPE_STOP,
+    OWISPS_CMDTYPE_OTHER,
+    OWISPS_NUM_CMDTYPES
+};
 
-#define OWISPS_POSSET_CMD    "PSET%d=%d"
-#define OWISPS_GETTARGET_CMD "?PSET%d"
+enum owispsCommandId {
+    OWISPS_CMD_AXISTYPE,
+    OWISPS_CMD_AXESSTAT,
+    OWISPS_CMD_LIMSTAT,
+    OWISPS_CMD_INIT,
+    OWISPS_CMD_MOFF,
+    OWISPS_CMD_MON,
+    OWISPS_CMD_STOP,
+    OWISPS_CMD_GETCOUNTER,
+    OWISPS_CMD_SETCOUNTER,
+    OWISPS_CMD_GETPOSVEL,
+    OWISPS_CMD_SETPOSVEL,
+    OWISPS_CMD_GETACC,
+    OWISPS_CMD_SETACC,
+    OWISPS_CMD_ABSCOORD,
+    OWISPS_CMD_RELCOORD,
+    OWISPS_CMD_POSSET,
+    OWISPS_CMD_GETTARGET,
+    OWISPS_CMD_POSGO,
+    OWISPS_CMD_HOME,
+    OWISPS_CMD_VERSION,
+    OWISPS_CMD_MSG,
+    OWISPS_NUM_CMDS
+};
 
-#define OWISPS_POSGO_CMD "PGO%d"
+enum owispsArgKind {
+    OWISPS_ARGS_NONE,      // e.g. ?ASTAT
+    OWISPS_ARGS_AXIS,      // e.g. PGO1
+    OWISPS_ARGS_AXIS_VALUE // e.g. PSET1=100
+};
 
-#define OWISPS_HOME_CMD "REF%d=%d"
+enum owispsReplyType {
+    OWISPS_REPLY_NONE,    // Not a query
+    OWISPS_REPLY_INTEGER, // Signed decimal integer
+    OWISPS_REPLY_STATUS,  // One status character per axis
+    OWISPS_REPLY_TEXT
+};
 
-#define OWISPS_VERSION_CMD "?VERSION"
-#define OWISPS_MSG_CMD     "?MSG"
+typedef struct {
+    const char *name;       // Command name, followed by its arguments
+    size_t length;          // Length of the name
+    owispsArgKind args;
+    owispsReplyType reply;
+    owispsCommandType type; // For the link statistics
+} owispsCommandDescriptor;
+
+typedef struct {
+    size_t buckets[OWISPS_LATENCY_BUCKETS]; // Bucket k counts latencies in [2^k, 2^(k+1)) us
+    size_t count;
+    size_t sum; // Microseconds
+    int min;    // Microseconds, negative if no sample
+} owispsLatencyHistogram;
+
+typedef struct {
+    epicsTimeStamp time;   // Start of the transfer
+    epicsUInt32 duration;  // Microseconds
+    char kind;             // OWISPS_TRACE_*
+    char status;           // asynStatus
+    epicsUInt16 length;    // Length of the command or reply, text holds up to OWISPS_TRACE_TEXT_SIZE characters of it
+    char text[OWISPS_TRACE_TEXT_SIZE];
+} owispsTraceEntry;
+
+typedef struct {
+    double offset;   // Seconds since the recording started
+    double duration; // Seconds
+    char kind;       // OWISPS_TRACE_*
+    int status;      // asynStatus
+    char text[MAX_OWISPS_SEQUENCE_SIZE];
+} owispsTranscriptEntry;
+
+typedef struct {
+    int axis;
+    int type;        // owispsAxisType
+    int homingType;  // OWISPS_REF_*
+    int velocity;    // PVEL, in counter steps/s
+    long counter;    // Last ?CNT while idle
+    int homed;       // Homed flag with that counter, -1 if no counter saved
+} owispsCacheEntry;
+
+typedef struct {
+    owispsIoType type;
+    int axis;
+    char commands[MAX_OWISPS_SEQUENCE_SIZE];
+} owispsIoRequest;
 
 
 
@@ -111,6 +275,7 @@ class OWISPSAxis: public asynMotorAxis {
 
 public:
     OWISPSAxis(class OWISPSController *pC, int axis);
+    virtual ~OWISPSAxis();
 
     // These are the methods we override from the base class
     void report(FILE *fp, int level);
@@ -126,22 +291,59 @@ public:
     static bool updateAxisReadbackPosition(asynStatus status, const char *reply, long& readback, asynStatus *asyn_error);
     static bool updateAxisLimitsStatus(asynStatus status, const char *reply, int& lim_switches, asynStatus *asyn_error);
     static bool updateAxisType(asynStatus status, const char *reply, owispsAxisType& ax_type, asynStatus *asyn_error);
+    static bool updateAxisVelocity(asynStatus status, const char *reply, int& velocity, asynStatus *asyn_error);
+
+    static double estimateMoveTime(double distance, double velocity, double acceleration);
+
+    static int captureRingIndex(int head, int count, int size, int sample);
 
-    static bool buildGenericCommand(char *buffer, const char *command_format, int axis);
-    static bool buildMoveCommand(char *buffer, int axis, double position);
-    static bool buildSetPositionCommand(char *buffer, int axis, double position);
-    static bool buildHomeCommand(char *buffer, int axis, int home_type);
+    static bool isMovingStatus(char owisps_status);
+    static epicsUInt8 statusFlags(char owisps_status);
 
-    static bool issigneddigit(const char *buffer) {
-        size_t buf_len = strlen(buffer);
-        if (buf_len == 1) return isdigit(*buffer);
-        if (buf_len > 1) return isdigit(*buffer) || (*buffer=='-' && isdigit(*++buffer));
-        return false;
-    }
+    static size_t parseInteger(const char *buffer, size_t size, long& value);
 
 protected:
     // Specific class methods
     virtual void updateAxisStatus(char owisps_status);
+    virtual asynStatus startMove(double position, int relative, double max_velocity, double acceleration);
+    virtual bool isPollDue(const epicsTimeStamp *now);
+    virtual void queuePollCommands(const epicsTimeStamp *now);
+    virtual void clearPollCommands(void);
+
+    // Discovery of the axis type and velocity, through the poll batches, in the background and after communication losses
+    virtual bool isDiscoveryDue(const epicsTimeStamp *now);
+    virtual void queueDiscoveryCommands(const epicsTimeStamp *now);
+    virtual bool processDiscoveryReplies(const epicsTimeStamp *now);
+    virtual void rediscover(void);
+    virtual void restoreCache(const owispsCacheEntry *entry);
+
+    // Counter persistence: saved while idle, the homed flag restored at startup if the controller still has the counter
+    virtual void persistCounter(long readback);
+    virtual void restoreHomed(long readback);
+    bool isDiscoveryQueued(void) { return this->typeReplyIdx >= 0; }
+    virtual void predictMotionDone(double distance, double acceleration);
+    virtual void updateStopLatency(double latency);
+
+    // Position list: the driver steps through the targets itself, as soon as each one is reached
+    virtual asynStatus startList(void);
+    virtual void abortList(void);
+    virtual void advanceList(double readback);
+
+    // Readback capture: every polled readback is kept, with its reply time and status, in a ring buffer
+    virtual asynStatus enableCapture(bool enable);
+    virtual void recordCapture(const epicsTimeStamp *reply_time, long readback);
+    virtual size_t readCapture(int function, void *value, size_t max_samples);
+
+    // Command sequences, written by the controller I/O thread
+    virtual void beginSequence(void);
+    virtual asynStatus appendSequence(owispsCommandId command, long value = 0);
+    virtual asynStatus sendSequence(void);
+
+    // Cached controller settings, only sent when changed
+    virtual asynStatus appendCoordinateMode(int relative);
+    virtual asynStatus appendVelocity(double velocity, double acceleration);
+    virtual void invalidateSettings(void);
+    bool isPollQueued(void) { return this->limitsReplyIdx >= 0; }
 
     virtual void setStatusProblem(asynStatus status);
 
@@ -150,27 +352,81 @@ protected:
     virtual asynStatus executePost(void);
 
     virtual asynStatus getIntegerParam(int index, epicsInt32 *value);
+    virtual asynStatus getDoubleParam(int index, double *value);
     virtual asynStatus getStringParam(int index, int max_chars, char *value);
 
+    // Change-tracked parameters, posted at most once per poll cycle by flushParams()
+    virtual asynStatus setIntegerParam(int index, int value);
+    virtual asynStatus setDoubleParam(int index, double value);
+    virtual asynStatus callParamCallbacks(void);
+    asynStatus flushParams(void);
+
     virtual void log(int reason, const char *format, ...);
 
     OWISPSController *pC_; // Pointer to the asynMotorController to which this axis belongs
 
     owispsAxisType axisType;
     int homingType;
+    int positionVelocity;     // Last known PVEL, 0 if unknown
+    int positionAcceleration; // Last ACC sent, 0 if unknown
 
 private:
     char axisStatus;
+
+    int limitsReplyIdx;  // Index of this axis' ?ESTAT reply in the controller poll batch
+    int counterReplyIdx; // Index of this axis' ?CNT reply in the controller poll batch
+    int typeReplyIdx;     // Index of this axis' ?MOTYPE reply in the controller poll batch, while discovering
+    int velocityReplyIdx; // Index of this axis' ?PVEL reply in the controller poll batch, while discovering
+    bool discovered;             // Type and velocity known, and controller reachable since
+    long savedCounter;           // Counter in the cache
+    int savedHomed;              // Homed flag in the cache, -1 if no counter saved
+    bool restorePending;         // Saved counter to be checked against the first readback, to restore the homed flag
+    epicsTimeStamp lastDiscovery; // Last time the type was queried
+    epicsTimeStamp lastRefresh; // Last time limits and readback were queried
+    bool forceRefresh;          // Commanded since last refresh, status must be processed even if unchanged
+    epicsTimeStamp expectedDone; // Predicted end of the ongoing move
+    double expectedDuration;     // Predicted duration of the ongoing move, negative if unknown
+    int commandCount;            // Incremented by every move/home, to detect replies gone stale while on the wire
+    int polledCommandCount;      // Value of commandCount when the last poll batch was sent
+    bool powerError;             // Power stage error already reported and motor switched off
+    bool paramsChanged;          // A parameter was changed since the last callbacks
+
+    char sequence[MAX_OWISPS_SEQUENCE_SIZE]; // Command sequence being built
+    size_t sequenceLength;                   // Length of the sequence being built
+    asynStatus ioStatus;                     // Failure of a sequence written by the I/O thread, guarded by ioStatusMutex
+
+    int coordinateMode; // Last ABSOL/RELAT sent, OWISPS_COORD_UNKNOWN after INIT or communication errors
+
+    bool deferredMove;   // Target set, PGO to be issued when deferred moves are released
+    double moveDistance; // Distance of the last move, for the motion done prediction
+
+    double listPositions[MAX_OWISPS_LIST_SIZE]; // Position list targets, in counter steps
+    double listReadbacks[MAX_OWISPS_LIST_SIZE]; // Readback once each target is reached
+    int listCount;              // Number of targets in the position list
+    int listIndex;              // Target being moved to, or dwelled at
+    bool listRunning;
+    bool listArrived;           // Current target reached, dwelling
+    epicsTimeStamp listArrival; // Time the current target was reached
+
+    double *captureTimes;     // Reply times, in seconds past the EPICS epoch, allocated when capture is first enabled
+    double *capturePositions; // Readbacks, in counter steps
+    char *captureStatus;      // Axis status characters
+    int captureHead;          // Next sample slot
+    int captureCount;         // Samples in the ring buffer
+    bool captureEnabled;
   
 friend class OWISPSController;
 };
 
 
 
+class OWISPSPoller;
+
 class OWISPSController: public asynMotorController {
 
 public:
     OWISPSController(const char *portName, const char *asynPortName, int numAxes, double movingPollPeriod, double idlePollPeriod);
+    ~OWISPSController();
 
     // These are the methods we override from the base class
     void report(FILE *fp, int level);
@@ -179,19 +435,210 @@ public:
     OWISPSAxis* getAxis(int axisNo);
 
     asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual);
+    asynStatus writeInt32(asynUser *pasynUser, epicsInt32 value);
+    asynStatus writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements);
+    asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nIn);
+    asynStatus readInt8Array(asynUser *pasynUser, epicsInt8 *value, size_t nElements, size_t *nIn);
 
     asynStatus poll();
+    void pollOnce(void);
+    bool isManualPolling(void);
+    asynStatus startPoller(double movingPollPeriod, double idlePollPeriod, int forcedFastPolls);
+    asynStatus wakeupPoller();
+
+    // Shared poller: one step of the poll cycle, never waiting for the serial link
+    double pollStep(void);
+
+    asynStatus setDeferredMoves(bool defer);
+
+    asynStatus initializeProfile(size_t maxPoints);
+    asynStatus buildProfile();
+    asynStatus executeProfile();
+    asynStatus abortProfile();
+
+    void profileThread(void);
+
+    // Serial I/O, serialized on ioMutex instead of the controller lock so that the poller can release the latter while on the wire
+    asynStatus writeController();
+    asynStatus writeReadController();
+    asynStatus writePriorityController(const char *command);
+    asynStatus queueController(OWISPSAxis *axis, const char *commands);
+
+    void ioThread(void);
+
+    void setForcedRefreshPeriod(double forcedRefreshPeriod);
 
     // Static class methods
-    static bool buildGenericCommand(char *buffer, const char *command_format);
+    static const owispsCommandDescriptor* commandDescriptor(owispsCommandId command);
+    static size_t formatCommand(char *buffer, size_t buffer_size, owispsCommandId command, int axis, long value = 0);
+    static size_t appendCommand(char *buffer, size_t buffer_size, size_t length, owispsCommandId command, int axis, long value = 0);
+    static size_t formatInteger(char *buffer, size_t buffer_size, long value);
+    static bool isReplyValid(owispsReplyType type, const char *reply, size_t length);
+    static owispsCommandType classifyCommand(const char *commands);
+    static int latencyBucket(int latency_us);
+    static double latencyPercentile(const size_t *buckets, size_t count, double fraction);
+    static double nextProbeBackoff(double backoff);
+    static void formatTraceEntry(const owispsTraceEntry *entry, char *buffer, size_t buffer_size);
+
+    void dumpTrace(FILE *fp, int count);
+
+    // Transcripts: the full serial traffic, poll cycles and moves, written to a file for replay
+    asynStatus startRecording(const char *fileName);
+    void stopRecording(void);
+    void recordMarker(char kind, const char *text);
+    static void formatTranscriptLine(const owispsTranscriptEntry *entry, char *buffer, size_t buffer_size);
+    static bool parseTranscriptLine(const char *line, owispsTranscriptEntry& entry);
+
+    // Axes configuration cache, keyed by port and firmware version: axes are usable before they are discovered
+    static void setCacheDirectory(const char *directory, bool restore);
+    void flushCache(void);
+    void syncCache(void);
+    void cacheThread(void);
+    static void formatCacheLine(const owispsCacheEntry *entry, char *buffer, size_t buffer_size);
+    static bool parseCacheLine(const char *line, owispsCacheEntry& entry);
+
+    // Harness-driven controllers: no poller, poll cycles only run by pollOnce()
+    static void setManualPolling(bool manual);
 
 protected:
     virtual void log(int reason, const char *format, ...);
 
+    // Pipelined transactions: several CR-separated queries written at once, replies read back in order
+    virtual void clearBatch(void);
+    virtual int queueBatchCommand(owispsCommandId command, int axis);
+    virtual asynStatus writeReadBatch(void);
+    virtual void transferBatch(void);
+    const char* getBatchReply(int index);
+    asynStatus getBatchStatus(int index);
+
+    // Poll cycle phases, run back-to-back by poll() or one step at a time by the shared poller
+    virtual bool beginPollCycle(void);
+    virtual bool processStatusReplies(void);
+    virtual void endPollCycle(void);
+    virtual double pollAxes(void);
+    virtual bool startPollTransfer(void);
+    OWISPSPoller *sharedPoller; // NULL if polled by the asynMotorController poller thread
+    bool manualPolling;         // No poller at all, polled by pollOnce() only
+    owispsPollPhase pollPhase;
+    int pollTransferDone;       // Poll batch transferred, set by the I/O thread
+    int pollStatusIdx;          // Index of the ?ASTAT reply in the poll batch
+    int pendingFastPolls;       // Fast polls left since the last wakeup
+    epicsTimeStamp pollStart;   // Start of the ongoing poll cycle
+    bool offline;               // Not answering: only ?ASTAT is polled, at nextProbe
+    double probeBackoff;        // Interval between probes, 0 while answering
+    epicsTimeStamp nextProbe;
+
+    virtual bool loadCache(void);
+    virtual bool saveCache(void);
+    virtual bool writeCache(void);
+    virtual void processVersionReply(void);
+    char cacheFile[MAX_OWISPS_PATH_SIZE];           // Empty if no cache
+    char cachedVersion[MAX_OWISPS_STRING_SIZE];     // Firmware version the cache was taken with, empty if none loaded
+    char firmwareVersion[MAX_OWISPS_STRING_SIZE];   // ?VERSION reply, empty until read, and after communication losses
+    int versionReplyIdx;                            // Index of the ?VERSION reply in the poll batch, -1 if not queued
+    bool cacheDirty;                                // Discovered configuration or counters to be saved
+
+    // Cache file contents, formatted under the controller lock and written by a low priority thread outside it
+    epicsMutexId cacheMutex;                        // Protects cacheSnapshot and cacheSnapshotSeq
+    epicsMutexId cacheWriteMutex;                   // Serializes writes of the cache file, protects cacheWriteBuffer and cacheWrittenSeq
+    epicsEventId cacheEvent;                        // Signals a new snapshot to the writer thread, NULL if none
+    epicsEventId cacheExitEvent;                    // Signaled by the writer thread when it stops
+    bool cacheExiting;                              // Writer thread to stop, set by the destructor
+    OWISPSController **cacheExitHook;               // Controller flushed at exit, NULL once destroyed
+    char *cacheSnapshot;
+    char *cacheWriteBuffer;
+    size_t cacheSnapshotSize;
+    int cacheSnapshotSeq;
+    int cacheWrittenSeq;
+
+    // Link statistics, updated lock-free on the I/O path and published once per OWISPS_STATS_PERIOD by the poller
+    virtual void recordTransaction(owispsCommandType type, const epicsTimeStamp *start, const epicsTimeStamp *end, size_t bytes, asynStatus status);
+    virtual void publishStatistics(const epicsTimeStamp *now);
+    virtual void resetStatistics(void);
+
+    // Serial traffic trace, always on: binary ring buffer, filled lock-free, dumped on demand
+    virtual void traceTransfer(char kind, const char *text, size_t length, const epicsTimeStamp *start, const epicsTimeStamp *end, asynStatus status);
+
+    char batchOutString[MAX_OWISPS_BATCH_STRING_SIZE];
+    size_t batchOutLength;
+    size_t batchOffsets[MAX_OWISPS_BATCH_SIZE]; // Where each query starts in batchOutString
+    size_t batchLengths[MAX_OWISPS_BATCH_SIZE];
+    owispsReplyType batchReplyTypes[MAX_OWISPS_BATCH_SIZE];
+    char batchInStrings[MAX_OWISPS_BATCH_SIZE][MAX_OWISPS_STRING_SIZE];
+    asynStatus batchStatus[MAX_OWISPS_BATCH_SIZE];
+    epicsTimeStamp batchTimes[MAX_OWISPS_BATCH_SIZE]; // Time each reply was read
+    owispsCommandType batchTypes[MAX_OWISPS_BATCH_SIZE];
+    int batchSize;
+    int batchPending; // First reply slot not yet transferred
+    asynStatus batchTransferStatus;
+
+    char axesStatus[MAX_OWISPS_STRING_SIZE]; // Last ?ASTAT reply
+    double forcedRefreshPeriod;              // Time after which idle and unchanged axes are refreshed anyway
+    epicsTimeStamp lastStatusPoll;           // Last time ?ASTAT was queried
+
+    owispsLatencyHistogram latencies[OWISPS_NUM_CMDTYPES];
+    size_t transactionCount;
+    size_t byteCount;
+    size_t timeoutCount;
+    size_t publishedTransactionCount; // Counts at the last publication, for the rates
+    size_t publishedByteCount;
+    epicsTimeStamp lastStatsPublish;
+
+    owispsTraceEntry *trace;
+    size_t traceCount; // Entries ever traced, the next one goes to traceCount % OWISPS_TRACE_SIZE
+
+    virtual void recordTranscript(char kind, const char *text, size_t length, const epicsTimeStamp *start, const epicsTimeStamp *end, asynStatus status);
+    FILE *recordFile; // Transcript being recorded, guarded by recordMutex
+    epicsMutexId recordMutex;
+    epicsTimeStamp recordStart;
+
     int driverInitParam;
     int driverPremParam;
     int driverPostParam;
-#define NUM_OWISPS_PARAMS 3
+    int driverStopLatencyParam;
+    int driverStopLatencyMaxParam;
+    int driverListPositionsParam;
+    int driverListDwellParam;
+    int driverListRunParam;
+    int driverListIndexParam;
+    int driverListReadbacksParam;
+    int driverCaptureParam;
+    int driverCaptureCountParam;
+    int driverCaptureTimesParam;
+    int driverCapturePositionsParam;
+    int driverCaptureStatusParam;
+    int driverLatencyMinParam[OWISPS_NUM_CMDTYPES];
+    int driverLatencyMeanParam[OWISPS_NUM_CMDTYPES];
+    int driverLatencyP99Param[OWISPS_NUM_CMDTYPES];
+    int driverLatencyCountParam[OWISPS_NUM_CMDTYPES];
+    int driverTransactionRateParam;
+    int driverByteRateParam;
+    int driverTimeoutsParam;
+    int driverPollCycleParam;
+    int driverStatsResetParam;
+#define NUM_OWISPS_PARAMS (20 + 4*OWISPS_NUM_CMDTYPES)
+
+    epicsMutexId ioMutex;
+
+    // I/O thread: owns the serial traffic of commands and polling, in request order
+    epicsMessageQueueId ioQueue;
+    epicsEventId batchDoneEvent;
+    epicsEventId ioExitEvent;    // Signaled by the I/O thread when it stops
+    epicsMutexId ioStatusMutex;
+
+    bool movesDeferred;
+
+    // Profile engine: points are fed one after the other, as soon as all profile axes are done
+    virtual bool isProfilePointDone(void);
+    epicsEventId profileExecuteEvent;
+    epicsEventId profilePointEvent;
+    bool profileExecuting;
+    bool profileAbortRequested;
+
+    // Priority lane: dedicated asynUser that locks the port directly, jumping ahead of queued requests
+    asynUser *pasynUserPriority;
+    asynOctet *pasynOctetPriority;
+    void *octetPriorityPvt;
 
 friend class OWISPSAxis;
 };
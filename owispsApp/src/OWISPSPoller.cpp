@@ -0,0 +1,265 @@
+/*
+FILENAME...   OWISPSPoller.cpp
+USAGE...      Poller threads shared by all the OWIS PS controllers of an IOC
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OWISPSPoller.h"
+
+#include <iocsh.h>
+#include <epicsThread.h>
+
+#include <epicsExport.h>
+
+
+
+static const char *driverName = "OWISPSPoller";
+
+static OWISPSPoller *sharedPoller = NULL;
+
+
+
+static void OWISPSPollerThreadC(void *pPvt) {
+    static_cast<OWISPSPoller*>(pPvt)->pollerThread();
+}
+
+/** Creates a new OWISPSPoller object and starts its threads.
+  * Each controller added is polled by whichever thread is free when its next poll step is due;
+  * a poll step never waits for the serial link, so a few threads serve many controllers.
+  *
+  * \param[in] numThreads The number of poller threads
+  */
+OWISPSPoller::OWISPSPoller(int numThreads) {
+    char thread_name[MAX_OWISPS_STRING_SIZE];
+
+    this->mutex = epicsMutexMustCreate();
+    this->event = epicsEventMustCreate(epicsEventEmpty);
+    this->numThreads = (numThreads < 1) ? 1 : ((numThreads > MAX_OWISPS_POLLER_THREADS) ? MAX_OWISPS_POLLER_THREADS : numThreads);
+    memset(this->entries, 0, sizeof(this->entries));
+    this->entryCount = 0;
+
+    for (int i=0; i<this->numThreads; i++) {
+        snprintf(thread_name, sizeof(thread_name), "OWISPSPoller%d", i);
+        if (!epicsThreadCreate(thread_name, epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackMedium), (EPICSTHREADFUNC)OWISPSPollerThreadC, this)) {
+            printf("%s: cannot create poller thread %d\n", driverName, i);
+        }
+    }
+}
+
+/** Adds a controller, not scheduled until its first wakeup.
+  *
+  * \param[in] pC Controller to be polled
+  *
+  * \return false if the poller is full
+  */
+bool OWISPSPoller::add(OWISPSController *pC) {
+    bool added = false;
+
+    epicsMutexMustLock(this->mutex);
+    if ((!findEntry(pC)) && (this->entryCount < MAX_OWISPS_POLLER_CONTROLLERS)) {
+        owispsPollerEntry *entry = &this->entries[this->entryCount++];
+        memset(entry, 0, sizeof(*entry));
+        entry->controller = pC;
+        added = true;
+    }
+    epicsMutexUnlock(this->mutex);
+
+    return added;
+}
+
+/** Schedules the next poll step of a controller.
+  * An earlier schedule is kept, so that wakeups and I/O completions are never postponed by the poll period.
+  * May be called while the controller poll step runs: it is then run again as soon as it ends.
+  *
+  * \param[in] pC     Controller
+  * \param[in] delay  Time from now, in seconds
+  */
+void OWISPSPoller::schedule(OWISPSController *pC, double delay) {
+    epicsTimeStamp due;
+    owispsPollerEntry *entry;
+
+    epicsTimeGetCurrent(&due);
+    epicsTimeAddSeconds(&due, (delay > 0) ? delay : 0);
+
+    epicsMutexMustLock(this->mutex);
+    entry = findEntry(pC);
+    if ((entry) && ((!entry->scheduled) || (epicsTimeDiffInSeconds(&due, &entry->due) < 0))) {
+        entry->due = due;
+        entry->scheduled = true;
+    }
+    epicsMutexUnlock(this->mutex);
+
+    epicsEventSignal(this->event);
+}
+
+/** Reports on the controllers served, their poll steps and worst lateness.
+  *
+  * \param[in] fp    The file pointer on which report information will be written
+  * \param[in] level The level of report detail desired
+  */
+void OWISPSPoller::report(FILE *fp, int level) {
+    epicsMutexMustLock(this->mutex);
+    fprintf(fp, "OWIS PS shared poller, threads=%d, controllers=%d\n", this->numThreads, this->entryCount);
+    if (level > 0) {
+        for (int i=0; i<this->entryCount; i++) {
+            fprintf(fp, "    %s: steps=%d, worst lateness=%.3f ms%s\n", this->entries[i].controller->portName, this->entries[i].steps, this->entries[i].lateness*1000., this->entries[i].busy ? ", polling" : "");
+        }
+    }
+    epicsMutexUnlock(this->mutex);
+}
+
+/** Runs the due poll steps, earliest first, and reschedules each controller at the period it asks for.
+  *
+  */
+void OWISPSPoller::pollerThread(void) {
+    owispsPollerEntry *entry;
+    double wait, delay;
+
+    while (true) {
+        epicsMutexMustLock(this->mutex);
+        entry = nextEntry(&wait);
+        if ((!entry) || (wait > 0)) {
+            epicsMutexUnlock(this->mutex);
+            if (entry) {
+                epicsEventWaitWithTimeout(this->event, wait);
+            } else {
+                epicsEventMustWait(this->event);
+            }
+            continue;
+        }
+        entry->scheduled = false;
+        entry->busy = true;
+        entry->steps++;
+        if (-wait > entry->lateness) {
+            entry->lateness = -wait;
+        }
+        epicsMutexUnlock(this->mutex);
+        epicsEventSignal(this->event); // Another thread may take the next due controller
+
+        delay = entry->controller->pollStep();
+
+        epicsMutexMustLock(this->mutex);
+        entry->busy = false;
+        epicsMutexUnlock(this->mutex);
+        if (delay >= 0) {
+            schedule(entry->controller, delay);
+        } else {
+            epicsEventSignal(this->event); // Rescheduled while busy
+        }
+    }
+}
+
+/** Accessor to the poller shared by all controllers, NULL if OWISPSCreatePollers was not called.
+  *
+  */
+OWISPSPoller* OWISPSPoller::getShared(void) {
+    return sharedPoller;
+}
+
+/** Creates the poller shared by all controllers created afterwards.
+  *
+  * \param[in] numThreads The number of poller threads
+  *
+  * \return false if it already exists
+  */
+bool OWISPSPoller::createShared(int numThreads) {
+    if (sharedPoller) {
+        return false;
+    }
+    sharedPoller = new OWISPSPoller(numThreads);
+    return true;
+}
+
+/** Finds the entry of a controller, must be called with the mutex held.
+  *
+  */
+owispsPollerEntry* OWISPSPoller::findEntry(OWISPSController *pC) {
+    for (int i=0; i<this->entryCount; i++) {
+        if (this->entries[i].controller == pC) {
+            return &this->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/** Finds the scheduled and idle entry due first, must be called with the mutex held.
+  * A linear scan: with at most MAX_OWISPS_POLLER_CONTROLLERS entries, cheaper than maintaining a timer wheel.
+  *
+  * \param[out] wait Time until it is due, in seconds, negative if overdue
+  *
+  * \return NULL if no controller is scheduled
+  */
+owispsPollerEntry* OWISPSPoller::nextEntry(double *wait) {
+    owispsPollerEntry *next = NULL;
+    epicsTimeStamp now;
+
+    for (int i=0; i<this->entryCount; i++) {
+        if ((this->entries[i].scheduled) && (!this->entries[i].busy)) {
+            if ((!next) || (epicsTimeDiffInSeconds(&this->entries[i].due, &next->due) < 0)) {
+                next = &this->entries[i];
+            }
+        }
+    }
+    if (next) {
+        epicsTimeGetCurrent(&now);
+        *wait = epicsTimeDiffInSeconds(&next->due, &now);
+    }
+    return next;
+}
+
+
+
+/** Creates the poller threads shared by the OWIS PS controllers created afterwards.
+  * Configuration command, called directly or from iocsh, before OWISPSCreateController
+  *
+  * \param[in] numThreads  The number of poller threads
+  */
+extern "C" int OWISPSCreatePollers(int numThreads) {
+    if (!OWISPSPoller::createShared(numThreads)) {
+        printf("%s:OWISPSCreatePollers: shared poller already created\n", driverName);
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSCreatePollersArg0 = { "Number of threads", iocshArgInt };
+static const iocshArg * const OWISPSCreatePollersArgs[] = { &OWISPSCreatePollersArg0 };
+static const iocshFuncDef OWISPSCreatePollersDef = { "OWISPSCreatePollers", 1, OWISPSCreatePollersArgs };
+static void OWISPSCreatePollersCallFunc(const iocshArgBuf *args) {
+    OWISPSCreatePollers(args[0].ival);
+}
+
+/** Reports on the shared poller threads.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] level  The level of report detail desired
+  */
+extern "C" int OWISPSPollerReport(int level) {
+    if (!OWISPSPoller::getShared()) {
+        printf("%s:OWISPSPollerReport: no shared poller\n", driverName);
+        return asynError;
+    }
+    OWISPSPoller::getShared()->report(stdout, level);
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSPollerReportArg0 = { "Report level", iocshArgInt };
+static const iocshArg * const OWISPSPollerReportArgs[] = { &OWISPSPollerReportArg0 };
+static const iocshFuncDef OWISPSPollerReportDef = { "OWISPSPollerReport", 1, OWISPSPollerReportArgs };
+static void OWISPSPollerReportCallFunc(const iocshArgBuf *args) {
+    OWISPSPollerReport(args[0].ival);
+}
+
+static void OWISPSPollerRegister(void) {
+    iocshRegister(&OWISPSCreatePollersDef, OWISPSCreatePollersCallFunc);
+    iocshRegister(&OWISPSPollerReportDef, OWISPSPollerReportCallFunc);
+}
+
+extern "C" {
+    epicsExportRegistrar(OWISPSPollerRegister);
+}
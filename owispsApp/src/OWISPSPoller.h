@@ -0,0 +1,63 @@
+/*
+FILENAME...   OWISPSPoller.h
+USAGE...      Poller threads shared by all the OWIS PS controllers of an IOC
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#ifndef _OWISPSPOLLER_H_
+#define _OWISPSPOLLER_H_
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+
+#include "OWISPSMotorDriver.h"
+
+
+
+#define MAX_OWISPS_POLLER_THREADS     16
+#define MAX_OWISPS_POLLER_CONTROLLERS 64
+
+
+
+typedef struct {
+    OWISPSController *controller;
+    epicsTimeStamp due; // Next poll step, valid if scheduled
+    bool scheduled;
+    bool busy;          // Poll step running in one of the threads
+    int steps;          // Poll steps run, for the report
+    double lateness;    // Worst delay between due time and poll step start, in seconds
+} owispsPollerEntry;
+
+
+
+class OWISPSPoller {
+
+public:
+    OWISPSPoller(int numThreads);
+
+    bool add(OWISPSController *pC);
+    void schedule(OWISPSController *pC, double delay);
+    void report(FILE *fp, int level);
+
+    void pollerThread(void);
+
+    // Class-wide methods
+    static OWISPSPoller* getShared(void);
+    static bool createShared(int numThreads);
+
+protected:
+    owispsPollerEntry* findEntry(OWISPSController *pC);
+    owispsPollerEntry* nextEntry(double *wait);
+
+    epicsMutexId mutex; // Guards the entries
+    epicsEventId event; // Signaled when an entry is scheduled or released
+
+    int numThreads;
+    owispsPollerEntry entries[MAX_OWISPS_POLLER_CONTROLLERS];
+    int entryCount;
+};
+
+#endif // _OWISPSPOLLER_H_
@@ -0,0 +1,453 @@
+/*
+FILENAME...   OWISPSReplay.cpp
+USAGE...      Replays a recorded OWIS PS serial transcript, to catch performance regressions without hardware
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "OWISPSReplay.h"
+
+#include <iocsh.h>
+#include <epicsThread.h>
+
+#include <epicsExport.h>
+
+
+
+static const char *driverName = "OWISPSReplay";
+
+
+
+static bool isCommandItem(const owispsReplayItem *item) {
+    return (item->kind == OWISPS_TRACE_WRITE) || (item->kind == OWISPS_TRACE_QUERY) || (item->kind == OWISPS_TRACE_PRIORITY);
+}
+
+
+
+/** Creates a new OWISPSReplay object, from a transcript written by OWISPSRecordStart.
+  * Until run() is called, it behaves as a plain simulator (infinitely fast link) so that the controller can discover its axes.
+  * While running, the commands written are matched against the recorded ones, and answered with the recorded
+  * replies after the recorded times; commands that were not recorded are counted and left to the simulator.
+  *
+  * \param[in] portName   The name of the asyn port that will be created for this replay
+  * \param[in] fileName   The transcript file
+  * \param[in] timeScale  Recorded times multiplier, 1 for real time, 0 to replay as fast as possible
+  */
+OWISPSReplay::OWISPSReplay(const char *portName, const char *fileName, double timeScale)
+    :OWISPSSimulator(portName, MAX_OWISPS_SIM_AXES, 0, 0) {
+    static const char *functionName = "OWISPSReplay";
+
+    this->timeScale = (timeScale > 0) ? timeScale : 0;
+    this->items = NULL;
+    this->itemCount = 0;
+    this->itemCapacity = 0;
+    this->recordedTransactions = 0;
+    this->recordedPort[0] = '\0';
+    this->recordedAxes = 0;
+    this->armed = false;
+    this->commandCursor = 0;
+    this->mismatches = 0;
+    this->skipped = 0;
+    this->writeDelay = 0;
+    for (int i=0; i<MAX_OWISPS_SIM_REPLIES; i++) {
+        this->replyDelays[i] = -1;
+    }
+
+    if (!load(fileName)) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, "%s:%s: cannot load transcript %s\n", driverName, functionName, fileName);
+    }
+}
+
+/** Destroys an OWISPSReplay object, once the controller replayed against is destroyed.
+  *
+  */
+OWISPSReplay::~OWISPSReplay() {
+    free(this->items);
+}
+
+/** Reports on status of the replay.
+  *
+  * \param[in] fp The file pointer on which report information will be written
+  * \param[in] level The level of report detail desired
+  */
+void OWISPSReplay::report(FILE *fp, int level) {
+    fprintf(fp, "OWIS PS replay %s, transcript of %s: %d items, %d transactions, time scale %g\n", this->portName, this->recordedPort, this->itemCount, this->recordedTransactions, this->timeScale);
+
+    OWISPSSimulator::report(fp, level);
+}
+
+/** Reads a transcript: writes are split into one item per command, and each recorded reply is attached to its query.
+  * Priority commands may be interleaved anywhere, so they neither start nor end a batch.
+  *
+  * \param[in] fileName The transcript file
+  *
+  * \return False if the file cannot be read or is not a transcript
+  */
+bool OWISPSReplay::load(const char *fileName) {
+    char line[MAX_OWISPS_SEQUENCE_SIZE+MAX_OWISPS_STRING_SIZE];
+    owispsTranscriptEntry entry;
+    char previous = 0;
+    int pending = 0; // First item of the transaction whose replies are being read
+    bool is_transcript = false;
+    FILE *fp = fileName ? fopen(fileName, "r") : NULL;
+
+    if (!fp) {
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, OWISPS_TRANSCRIPT_HEADER, strlen(OWISPS_TRANSCRIPT_HEADER)) == 0) {
+            sscanf(line+strlen(OWISPS_TRANSCRIPT_HEADER), "%79s %d", this->recordedPort, &this->recordedAxes);
+            is_transcript = true;
+            continue;
+        }
+        if (!OWISPSController::parseTranscriptLine(line, entry)) {
+            continue;
+        }
+
+        switch (entry.kind) {
+            case OWISPS_TRACE_WRITE:
+            case OWISPS_TRACE_QUERY:
+            case OWISPS_TRACE_PRIORITY:
+                if (entry.kind == OWISPS_TRACE_PRIORITY) {
+                    this->recordedTransactions++;
+                } else if ((entry.kind == OWISPS_TRACE_WRITE) || (previous != OWISPS_TRACE_QUERY)) {
+                    this->recordedTransactions++;
+                    pending = this->itemCount;
+                }
+                for (const char *command=entry.text; *command; ) {
+                    size_t len = strcspn(command, "\r");
+                    appendItem(entry.kind, entry.offset, (command == entry.text) ? entry.duration : 0, command, len);
+                    command += len;
+                    if (*command) {
+                        command++;
+                    }
+                }
+                if (entry.kind != OWISPS_TRACE_PRIORITY) {
+                    previous = entry.kind;
+                }
+                break;
+
+            case OWISPS_TRACE_REPLY:
+                appendItem(entry.kind, entry.offset, entry.duration, entry.text, strlen(entry.text));
+                while ((pending < this->itemCount-1) && ((this->items[pending].kind == OWISPS_TRACE_PRIORITY) || (!isCommandItem(&this->items[pending])) || (!isQuery(this->items[pending].text)))) {
+                    pending++;
+                }
+                if (pending < this->itemCount-1) {
+                    this->items[pending++].reply = this->itemCount-1;
+                }
+                previous = entry.kind;
+                break;
+
+            default: // Markers
+                appendItem(entry.kind, entry.offset, entry.duration, entry.text, strlen(entry.text));
+                break;
+        }
+    }
+
+    fclose(fp);
+    return is_transcript;
+}
+
+void OWISPSReplay::appendItem(char kind, double offset, double duration, const char *text, size_t length) {
+    owispsReplayItem *item;
+
+    if (this->itemCount == this->itemCapacity) {
+        int capacity = this->itemCapacity ? 2*this->itemCapacity : 1024;
+        owispsReplayItem *grown = (owispsReplayItem*)realloc(this->items, capacity*sizeof(owispsReplayItem));
+        if (!grown) {
+            return;
+        }
+        this->items = grown;
+        this->itemCapacity = capacity;
+    }
+
+    item = &this->items[this->itemCount++];
+    if (length >= sizeof(item->text)) {
+        length = sizeof(item->text)-1;
+    }
+    memcpy(item->text, text, length);
+    item->text[length] = '\0';
+    item->kind = kind;
+    item->offset = offset;
+    item->duration = duration;
+    item->reply = -1;
+}
+
+/** Finds a command among the next OWISPS_REPLAY_WINDOW recorded ones.
+  *
+  * \return Item index, -1 if not found
+  */
+int OWISPSReplay::findCommand(const char *command) {
+    int searched = 0;
+
+    for (int i=this->commandCursor; (i<this->itemCount) && (searched<OWISPS_REPLAY_WINDOW); i++) {
+        if (isCommandItem(&this->items[i])) {
+            if (strcmp(this->items[i].text, command) == 0) {
+                return i;
+            }
+            searched++;
+        }
+    }
+    return -1;
+}
+
+/** Executes the CR-separated commands written, then waits for the recorded time of the write.
+  *
+  */
+asynStatus OWISPSReplay::writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual) {
+    asynStatus status;
+
+    this->writeDelay = 0;
+    status = OWISPSSimulator::writeOctet(pasynUser, value, maxChars, nActual);
+    if ((this->armed) && (this->writeDelay > 0) && (this->timeScale > 0)) {
+        epicsThreadSleep(this->writeDelay*this->timeScale);
+    }
+
+    return status;
+}
+
+/** Matches a command against the recorded ones, queueing the recorded reply of a query.
+  * Recorded commands skipped to resynchronize are counted, and so are the commands that were not recorded.
+  *
+  * \param[in] command Command, without CR
+  */
+void OWISPSReplay::executeCommand(const char *command) {
+    int match, queued = this->replyCount;
+    owispsReplayItem *item;
+
+    if (!this->armed) {
+        OWISPSSimulator::executeCommand(command);
+        return;
+    }
+
+    match = findCommand(command);
+    if (match < 0) {
+        this->mismatches++;
+        OWISPSSimulator::executeCommand(command);
+        for (int i=queued; i<this->replyCount; i++) {
+            this->replyDelays[(this->replyHead+i) % MAX_OWISPS_SIM_REPLIES] = -1;
+        }
+        return;
+    }
+
+    for (int i=this->commandCursor; i<match; i++) {
+        if (isCommandItem(&this->items[i])) {
+            this->skipped++;
+        }
+    }
+    this->commandCursor = match+1;
+    epicsTimeGetCurrent(&this->lastMatch);
+
+    item = &this->items[match];
+    this->writeDelay += item->duration;
+    if (item->reply >= 0) {
+        queueReply("%s", this->items[item->reply].text);
+        if (this->replyCount > queued) {
+            this->replyDelays[(this->replyHead+queued) % MAX_OWISPS_SIM_REPLIES] = this->items[item->reply].duration;
+        }
+    } else if (!isQuery(command)) {
+        OWISPSSimulator::executeCommand(command); // Keeps the simulated axes in step
+    }
+}
+
+/** Gives the recorded time of the oldest pending reply, or the simulated one if it was not recorded.
+  *
+  */
+double OWISPSReplay::replyTime(size_t length) {
+    double delay = this->replyDelays[this->replyHead];
+
+    if ((!this->armed) || (delay < 0)) {
+        return OWISPSSimulator::replyTime(length);
+    }
+    return delay*this->timeScale;
+}
+
+/** Gives the number of axes of the recorded controller, for creating the one to replay against.
+  *
+  */
+int OWISPSReplay::getRecordedAxes(void) {
+    return this->recordedAxes;
+}
+
+bool OWISPSReplay::isQuery(const char *command) {
+    return strchr(command, '?') != NULL;
+}
+
+/** Replays the transcript against a controller: poll cycles, moves and homings are issued at their recorded times,
+  * the controller should thus be manually polled (OWISPSConfigManualPolling) so that no poller interferes.
+  * Compares the recorded and replayed traffic once the controller stops writing: the time is up to the last recorded command.
+  *
+  * \param[in] pC  The controller, connected to this port
+  * \param[in] fp  The file pointer on which the comparison will be written
+  *
+  * \return True if the commands written were the recorded ones, in no more transactions and about the same time
+  */
+bool OWISPSReplay::run(OWISPSController *pC, FILE *fp) {
+    epicsTimeStamp start, now;
+    int writes, reads, cursor, previous_cursor = -1, last_command = -1, recorded_replies = 0;
+    long bytes;
+    double recorded = 0, replayed, elapsed;
+    OWISPSAxis *axis;
+
+    if (!pC->isManualPolling()) {
+        fprintf(fp, "%s: controller not manually polled, cannot replay\n", this->portName);
+        return false;
+    }
+    pC->pollOnce(); // Axes discovery, answered by the simulator until armed
+
+    lock();
+    flushOctet(this->pasynUserSelf);
+    resetStatistics();
+    this->commandCursor = 0;
+    this->mismatches = 0;
+    this->skipped = 0;
+    this->armed = true;
+    epicsTimeGetCurrent(&start);
+    this->lastMatch = start;
+    unlock();
+
+    for (int i=0; i<this->itemCount; i++) {
+        const owispsReplayItem *item = &this->items[i];
+        int axis_no = 0, relative = 0;
+        double position = 0, velocity = 0, acceleration = 0;
+
+        if (isCommandItem(item)) {
+            last_command = i;
+            if (item->offset+item->duration > recorded) {
+                recorded = item->offset+item->duration;
+            }
+            continue;
+        }
+        if (item->kind == OWISPS_TRACE_REPLY) {
+            recorded_replies++;
+            continue;
+        }
+
+        epicsTimeGetCurrent(&now);
+        elapsed = item->offset*this->timeScale - epicsTimeDiffInSeconds(&now, &start);
+        if (elapsed > 0) {
+            epicsThreadSleep(elapsed);
+        }
+
+        switch (item->kind) {
+            case OWISPS_TRACE_CYCLE:
+                pC->pollOnce();
+                break;
+            case OWISPS_TRACE_MOVE:
+                if ((sscanf(item->text, "%d %lf %d %lf %lf", &axis_no, &position, &relative, &velocity, &acceleration) == 5) && (axis = pC->getAxis(axis_no))) {
+                    pC->lock();
+                    axis->move(position, relative, 0, velocity, acceleration);
+                    pC->unlock();
+                }
+                break;
+            case OWISPS_TRACE_HOME:
+                if ((sscanf(item->text, "%d %lf", &axis_no, &acceleration) == 2) && (axis = pC->getAxis(axis_no))) {
+                    pC->lock();
+                    axis->home(0, 0, acceleration, 1);
+                    pC->unlock();
+                }
+                break;
+        }
+    }
+
+    // Commands still queued to the controller I/O thread
+    while (true) {
+        lock();
+        cursor = this->commandCursor;
+        unlock();
+        if ((cursor > last_command) || (cursor == previous_cursor)) {
+            break;
+        }
+        previous_cursor = cursor;
+        epicsThreadSleep(OWISPS_REPLAY_SETTLE);
+    }
+
+    lock();
+    this->armed = false;
+    replayed = epicsTimeDiffInSeconds(&this->lastMatch, &start);
+    for (int i=this->commandCursor; i<this->itemCount; i++) {
+        if (isCommandItem(&this->items[i])) {
+            this->skipped++;
+        }
+    }
+    getStatistics(writes, reads, bytes);
+    unlock();
+
+    fprintf(fp, "Replay of %s on %s, time scale %g:\n", this->recordedPort, pC->portName, this->timeScale);
+    fprintf(fp, "  transactions  recorded %8d  replayed %8d\n", this->recordedTransactions, writes);
+    fprintf(fp, "  replies       recorded %8d  replayed %8d\n", recorded_replies, reads);
+    fprintf(fp, "  time          recorded %8.3f  replayed %8.3f s\n", recorded*this->timeScale, replayed);
+    fprintf(fp, "  %d commands not recorded, %d recorded commands not replayed\n", this->mismatches, this->skipped);
+
+    if ((this->mismatches > 0) || (this->skipped > 0) || (writes > this->recordedTransactions)) {
+        return false;
+    }
+    return (this->timeScale <= 0) || (replayed <= recorded*this->timeScale*(1+OWISPS_REPLAY_SLACK));
+}
+
+
+
+/** Creates a new OWISPSReplay object.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName   The name of the asyn port that will be created for this replay
+  * \param[in] fileName   The transcript file, written by OWISPSRecordStart
+  * \param[in] timeScale  Recorded times multiplier, 1 for real time, 0 to replay as fast as possible
+  */
+extern "C" int OWISPSCreateReplay(const char *portName, const char *fileName, double timeScale) {
+    new OWISPSReplay(portName, fileName, timeScale);
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSCreateReplayArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSCreateReplayArg1 = { "File name", iocshArgString };
+static const iocshArg OWISPSCreateReplayArg2 = { "Time scale", iocshArgDouble };
+static const iocshArg * const OWISPSCreateReplayArgs[] = { &OWISPSCreateReplayArg0,
+                                                           &OWISPSCreateReplayArg1,
+                                                           &OWISPSCreateReplayArg2 };
+static const iocshFuncDef OWISPSCreateReplayDef = { "OWISPSCreateReplay", 3, OWISPSCreateReplayArgs };
+static void OWISPSCreateReplayCallFunc(const iocshArgBuf *args) {
+    OWISPSCreateReplay(args[0].sval, args[1].sval, args[2].dval);
+}
+
+/** Replays a transcript against an existing OWISPSController object, connected to an OWISPSReplay port.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName        The name of the asyn port of the OWISPSController
+  * \param[in] replayPortName  The name of the OWISPSReplay port
+  *
+  * \return asynError if either port does not exist, or the replay diverged from the transcript
+  */
+extern "C" int OWISPSRunReplay(const char *portName, const char *replayPortName) {
+    OWISPSController *pC = dynamic_cast<OWISPSController*>(static_cast<asynPortDriver*>(findAsynPortDriver(portName)));
+    OWISPSReplay *pR = dynamic_cast<OWISPSReplay*>(static_cast<asynPortDriver*>(findAsynPortDriver(replayPortName)));
+    if ((!pC) || (!pR)) {
+        printf("%s:OWISPSRunReplay: cannot find OWIS PS controller %s or replay %s\n", driverName, portName, replayPortName);
+        return asynError;
+    }
+    return pR->run(pC, stdout) ? asynSuccess : asynError;
+}
+
+static const iocshArg OWISPSRunReplayArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSRunReplayArg1 = { "Replay port name", iocshArgString };
+static const iocshArg * const OWISPSRunReplayArgs[] = { &OWISPSRunReplayArg0,
+                                                        &OWISPSRunReplayArg1 };
+static const iocshFuncDef OWISPSRunReplayDef = { "OWISPSRunReplay", 2, OWISPSRunReplayArgs };
+static void OWISPSRunReplayCallFunc(const iocshArgBuf *args) {
+    OWISPSRunReplay(args[0].sval, args[1].sval);
+}
+
+static void OWISPSReplayRegister(void) {
+    iocshRegister(&OWISPSCreateReplayDef, OWISPSCreateReplayCallFunc);
+    iocshRegister(&OWISPSRunReplayDef, OWISPSRunReplayCallFunc);
+}
+
+extern "C" {
+    epicsExportRegistrar(OWISPSReplayRegister);
+}
@@ -0,0 +1,75 @@
+/*
+FILENAME...   OWISPSReplay.h
+USAGE...      Replays a recorded OWIS PS serial transcript, to catch performance regressions without hardware
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#ifndef _OWISPSREPLAY_H_
+#define _OWISPSREPLAY_H_
+
+#include "OWISPSSimulator.h"
+
+
+
+#define OWISPS_REPLAY_WINDOW  32 // Recorded commands searched ahead to resynchronize after a mismatch
+#define OWISPS_REPLAY_SETTLE  1. // Seconds without traffic before a replay is considered finished
+#define OWISPS_REPLAY_SLACK   0.1 // Relative wall time increase flagged as a regression
+
+
+
+typedef struct {
+    char kind;       // OWISPS_TRACE_*, writes split into one item per command
+    double offset;   // Seconds since the recording started
+    double duration; // Recorded time taken, 0 for all but the first command of a write
+    int reply;       // Item holding the recorded reply of a query, -1 if none
+    char text[MAX_OWISPS_STRING_SIZE];
+} owispsReplayItem;
+
+
+
+class OWISPSReplay: public OWISPSSimulator {
+
+public:
+    OWISPSReplay(const char *portName, const char *fileName, double timeScale);
+    ~OWISPSReplay();
+
+    // These are the methods we override from the base class
+    void report(FILE *fp, int level);
+
+    asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual);
+
+    bool run(OWISPSController *pC, FILE *fp);
+    int getRecordedAxes(void);
+
+    // Class-wide methods
+    static bool isQuery(const char *command);
+
+protected:
+    bool load(const char *fileName);
+    void appendItem(char kind, double offset, double duration, const char *text, size_t length);
+    int findCommand(const char *command);
+
+    virtual void executeCommand(const char *command);
+    virtual double replyTime(size_t length);
+
+    double timeScale; // Recorded times multiplier, 0 to replay as fast as possible
+
+    owispsReplayItem *items;
+    int itemCount;
+    int itemCapacity;
+    int recordedTransactions; // Write calls recorded: sequences, priority commands and batches
+    char recordedPort[MAX_OWISPS_STRING_SIZE];
+    int recordedAxes;
+
+    bool armed;         // Replaying, the plain simulator answers otherwise
+    int commandCursor;  // Next recorded item to match
+    int mismatches;     // Commands written that were not recorded
+    int skipped;        // Recorded commands that were not written
+    double writeDelay;  // Recorded time of the write being replayed
+    epicsTimeStamp lastMatch; // When the last recorded command was written
+    double replyDelays[MAX_OWISPS_SIM_REPLIES]; // Recorded time of each pending reply, -1 for simulated ones
+};
+
+#endif // _OWISPSREPLAY_H_
@@ -0,0 +1,435 @@
+/*
+FILENAME...   OWISPSSimulator.cpp
+USAGE...      Simulated OWIS PS controller, as an asyn octet port, for testing and benchmarking without hardware
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "OWISPSSimulator.h"
+
+#include <iocsh.h>
+#include <epicsThread.h>
+
+#include <epicsExport.h>
+
+
+
+static const char *driverName = "OWISPSSimulator";
+
+
+
+/** Creates a new OWISPSSimulator object.
+  * Commands written are executed at once, their replies are read one per read call (input EOS stripped);
+  * write and read calls take as long as the simulated link would.
+  * Axes start as stepper-motors in open-loop, ready at counter 0.
+  *
+  * \param[in] portName        The name of the asyn port that will be created for this simulator
+  * \param[in] numAxes         The number of axes of the simulated PS
+  * \param[in] baudRate        The simulated link speed, 0 for an infinitely fast link
+  * \param[in] turnaroundTime  The time between a command and its reply, in seconds
+  */
+OWISPSSimulator::OWISPSSimulator(const char *portName, int numAxes, int baudRate, double turnaroundTime)
+    :asynPortDriver(portName, 1, 0,
+                    asynOctetMask | asynDrvUserMask,
+                    0,
+                    ASYN_CANBLOCK,
+                    1, /* autoconnect */
+                    0, 0) /* Default priority and stack size */ {
+    this->byteTime = (baudRate > 0) ? (double)OWISPS_SIM_BITS_PER_BYTE/baudRate : 0;
+    this->turnaroundTime = (turnaroundTime > 0) ? turnaroundTime : 0;
+    this->answering = true;
+    this->numAxes = (numAxes < 1) ? 1 : ((numAxes > MAX_OWISPS_SIM_AXES) ? MAX_OWISPS_SIM_AXES : numAxes);
+    this->replyHead = 0;
+    this->replyCount = 0;
+    resetStatistics();
+
+    memset(this->axes, 0, sizeof(this->axes));
+    for (int i=0; i<this->numAxes; i++) {
+        this->axes[i].status = OWISPS_STATUS_READY;
+        this->axes[i].coordinateMode = OWISPS_COORD_ABSOLUTE;
+        this->axes[i].velocity = OWISPS_SIM_DEFAULT_VELOCITY;
+        this->axes[i].acceleration = OWISPS_SIM_DEFAULT_ACCELERATION;
+    }
+}
+
+/** Reports on status of the simulator.
+  *
+  * \param[in] fp The file pointer on which report information will be written
+  * \param[in] level The level of report detail desired
+  */
+void OWISPSSimulator::report(FILE *fp, int level) {
+    epicsTimeStamp now;
+
+    fprintf(fp, "OWIS PS simulator %s, %d axes, byte time %g s, turnaround %g s\n", this->portName, this->numAxes, this->byteTime, this->turnaroundTime);
+    if (level > 0) {
+        epicsTimeGetCurrent(&now);
+        for (int i=0; i<this->numAxes; i++) {
+            updateAxis(&this->axes[i], &now);
+            fprintf(fp, "  axis %d: status %c, counter %d, target %d\n", i+1, this->axes[i].status, (int)this->axes[i].position, this->axes[i].target);
+        }
+    }
+
+    asynPortDriver::report(fp, level);
+}
+
+/** Executes the CR-separated commands written, after the time taken to transfer them; lost if not answering.
+  *
+  * \param[in]  pasynUser  asynUser structure
+  * \param[in]  value      Commands
+  * \param[in]  maxChars   Number of characters to write
+  * \param[out] nActual    Number of characters written
+  *
+  * \return Always asynSuccess
+  */
+asynStatus OWISPSSimulator::writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual) {
+    char command[MAX_OWISPS_STRING_SIZE];
+    size_t len = 0;
+
+    if (this->byteTime > 0) {
+        epicsThreadSleep((maxChars+1)*this->byteTime);
+    }
+
+    for (size_t i=0; i<=maxChars; i++) {
+        if ((i == maxChars) || (value[i] == '\r') || (value[i] == '\n')) {
+            if ((len > 0) && (this->answering)) {
+                command[len] = '\0';
+                executeCommand(command);
+            }
+            len = 0;
+        } else if (len < sizeof(command)-1) {
+            command[len++] = value[i];
+        }
+    }
+
+    this->writeCount++;
+    this->byteCount += maxChars+1;
+
+    *nActual = maxChars;
+    return asynSuccess;
+}
+
+/** Reads the oldest pending reply, after the turnaround and transfer time.
+  *
+  * \param[in]  pasynUser  asynUser structure
+  * \param[out] value      Reply
+  * \param[in]  maxChars   Size of the reply buffer
+  * \param[out] nActual    Number of characters read
+  * \param[out] eomReason  ASYN_EOM_EOS
+  *
+  * \return asynTimeout if there is no pending reply
+  */
+asynStatus OWISPSSimulator::readOctet(asynUser *pasynUser, char *value, size_t maxChars, size_t *nActual, int *eomReason) {
+    size_t len;
+
+    *nActual = 0;
+    if (!this->replyCount) {
+        epicsThreadSleep(pasynUser->timeout);
+        return asynTimeout;
+    }
+
+    const char *reply = this->replies[this->replyHead];
+    len = strlen(reply);
+    if (len > maxChars) {
+        len = maxChars;
+    }
+    epicsThreadSleep(replyTime(len));
+
+    memcpy(value, reply, len);
+    if (len < maxChars) {
+        value[len] = '\0';
+    }
+    *nActual = len;
+    if (eomReason) {
+        *eomReason = ASYN_EOM_EOS;
+    }
+
+    this->replyHead = (this->replyHead+1) % MAX_OWISPS_SIM_REPLIES;
+    this->replyCount--;
+    this->readCount++;
+    this->byteCount += len+1;
+
+    return asynSuccess;
+}
+
+/** Discards the pending replies.
+  *
+  * \param[in] pasynUser  asynUser structure
+  *
+  * \return Always asynSuccess
+  */
+asynStatus OWISPSSimulator::flushOctet(asynUser *pasynUser) {
+    this->replyHead = 0;
+    this->replyCount = 0;
+    return asynSuccess;
+}
+
+/** Gives the link statistics since creation or the last reset.
+  * The caller must hold the simulator lock.
+  *
+  * \param[out] writes Number of write calls
+  * \param[out] reads  Number of replies read
+  * \param[out] bytes  Number of bytes transferred both ways
+  */
+void OWISPSSimulator::getStatistics(int& writes, int& reads, long& bytes) {
+    writes = this->writeCount;
+    reads = this->readCount;
+    bytes = this->byteCount;
+}
+
+void OWISPSSimulator::resetStatistics(void) {
+    this->writeCount = 0;
+    this->readCount = 0;
+    this->byteCount = 0;
+}
+
+/** Simulates a controller off or disconnected: while not answering, commands written are lost, and reads time out.
+  * The caller must hold the simulator lock.
+  *
+  * \param[in] answering False to start the outage, true to end it
+  */
+void OWISPSSimulator::setAnswering(bool answering) {
+    this->answering = answering;
+}
+
+/** Executes one command, queueing its reply if it is a query.
+  * Unknown commands and invalid axes are ignored, unknown queries are not replied to.
+  *
+  * \param[in] command Command, without CR
+  */
+void OWISPSSimulator::executeCommand(const char *command) {
+    char name[MAX_OWISPS_STRING_SIZE];
+    const char *p = command;
+    size_t len = 0;
+    int axis_no = 0, value = 0;
+    bool has_value = false;
+    owispsSimAxis *axis = NULL;
+    epicsTimeStamp now;
+
+    while ((*p) && ((*p == '?') || isalpha((unsigned char)*p)) && (len < sizeof(name)-1)) {
+        name[len++] = *p++;
+    }
+    name[len] = '\0';
+    if (isdigit((unsigned char)*p)) {
+        axis_no = strtol(p, (char**)&p, 10);
+    }
+    if (*p == '=') {
+        value = strtol(p+1, NULL, 10);
+        has_value = true;
+    }
+
+    epicsTimeGetCurrent(&now);
+
+    if (!strcmp(name, "?ASTAT")) {
+        char status[MAX_OWISPS_SIM_AXES+1];
+        for (int i=0; i<this->numAxes; i++) {
+            updateAxis(&this->axes[i], &now);
+            status[i] = this->axes[i].status;
+        }
+        status[this->numAxes] = '\0';
+        queueReply("%s", status);
+        return;
+    }
+    if (!strcmp(name, "?VERSION")) {
+        queueReply("%s", OWISPS_SIM_VERSION);
+        return;
+    }
+    if (!strcmp(name, "?MSG")) {
+        queueReply("%s", "");
+        return;
+    }
+
+    if ((axis_no < 1) || (axis_no > this->numAxes)) {
+        return;
+    }
+    axis = &this->axes[axis_no-1];
+    updateAxis(axis, &now);
+
+    if (!strcmp(name, "?MOTYPE")) {
+        queueReply("%d", STEPPER_OPENLOOP);
+    } else if (!strcmp(name, "?ESTAT")) {
+        queueReply("%d", 0);
+    } else if (!strcmp(name, "?CNT")) {
+        queueReply("%d", (int)lround(axis->position));
+    } else if (!strcmp(name, "CNT") && has_value) {
+        if (!OWISPSAxis::isMovingStatus(axis->status)) {
+            axis->position = value;
+        }
+    } else if (!strcmp(name, "?PVEL")) {
+        queueReply("%d", axis->velocity);
+    } else if (!strcmp(name, "PVEL") && has_value) {
+        axis->velocity = value;
+    } else if (!strcmp(name, "?ACC")) {
+        queueReply("%d", axis->acceleration);
+    } else if (!strcmp(name, "ACC") && has_value) {
+        axis->acceleration = value;
+    } else if (!strcmp(name, "?PSET")) {
+        queueReply("%d", axis->target);
+    } else if (!strcmp(name, "PSET") && has_value) {
+        axis->target = value;
+    } else if (!strcmp(name, "ABSOL")) {
+        axis->coordinateMode = OWISPS_COORD_ABSOLUTE;
+    } else if (!strcmp(name, "RELAT")) {
+        axis->coordinateMode = OWISPS_COORD_RELATIVE;
+    } else if (!strcmp(name, "PGO")) {
+        if (axis->status == OWISPS_STATUS_READY) {
+            startMove(axis, (axis->coordinateMode == OWISPS_COORD_RELATIVE) ? axis->target : axis->target-axis->position, OWISPS_STATUS_POSTRAP);
+        }
+    } else if (!strcmp(name, "REF")) {
+        if (axis->status == OWISPS_STATUS_READY) {
+            startMove(axis, -axis->position, OWISPS_STATUS_HOMING);
+        }
+    } else if (!strcmp(name, "STOP")) {
+        if (OWISPSAxis::isMovingStatus(axis->status)) {
+            axis->status = OWISPS_STATUS_READY;
+        }
+    } else if ((!strcmp(name, "INIT")) || (!strcmp(name, "MON"))) {
+        if (!OWISPSAxis::isMovingStatus(axis->status)) {
+            axis->status = OWISPS_STATUS_READY;
+        }
+    } else if (!strcmp(name, "MOFF")) {
+        axis->status = OWISPS_STATUS_DISABLED;
+    }
+}
+
+/** Advances the kinematic model of a moving axis up to now.
+  *
+  * \param[in] axis Simulated axis
+  * \param[in] now  Current time
+  */
+void OWISPSSimulator::updateAxis(owispsSimAxis *axis, const epicsTimeStamp *now) {
+    double traveled;
+
+    if (!OWISPSAxis::isMovingStatus(axis->status)) {
+        return;
+    }
+
+    bool done = profilePosition(axis->distance, axis->velocity, axis->acceleration, epicsTimeDiffInSeconds(now, &axis->startTime), traveled);
+    axis->position = axis->startPosition + ((axis->distance < 0) ? -traveled : traveled);
+
+    if (done) {
+        axis->status = OWISPS_STATUS_READY;
+    }
+}
+
+/** Starts a move of the kinematic model.
+  *
+  * \param[in] axis     Simulated axis
+  * \param[in] distance Signed distance, in counter steps
+  * \param[in] status   Status while moving
+  */
+void OWISPSSimulator::startMove(owispsSimAxis *axis, double distance, char status) {
+    epicsTimeGetCurrent(&axis->startTime);
+    axis->startPosition = axis->position;
+    axis->distance = distance;
+    axis->status = (axis->velocity > 0) ? status : OWISPS_STATUS_READY;
+}
+
+/** Gives the time taken by the oldest pending reply: turnaround and transfer time.
+  *
+  * \param[in] length Reply length, without EOS
+  */
+double OWISPSSimulator::replyTime(size_t length) {
+    return this->turnaroundTime + (length+1)*this->byteTime;
+}
+
+/** Queues a reply, dropping it if too many are pending.
+  *
+  */
+void OWISPSSimulator::queueReply(const char *format, ...) {
+    va_list pArg;
+
+    if (this->replyCount >= MAX_OWISPS_SIM_REPLIES) {
+        asynPrint(this->pasynUserSelf, ASYN_TRACE_ERROR, "%s:queueReply: reply queue full\n", driverName);
+        return;
+    }
+
+    va_start(pArg, format);
+    vsnprintf(this->replies[(this->replyHead+this->replyCount) % MAX_OWISPS_SIM_REPLIES], MAX_OWISPS_STRING_SIZE, format, pArg);
+    va_end(pArg);
+    this->replyCount++;
+}
+
+/** Computes the distance traveled along a trapezoidal (or triangular) velocity profile, see OWISPSAxis::estimateMoveTime().
+  *
+  * \param[in]  distance     Distance to travel, in counter steps
+  * \param[in]  velocity     Cruise velocity, in counter steps/s
+  * \param[in]  acceleration Acceleration, in counter steps/s^2 (0 for instantaneous)
+  * \param[in]  elapsed      Time since the move started, in seconds
+  * \param[out] traveled     Distance traveled
+  *
+  * \return True if the move is done
+  */
+bool OWISPSSimulator::profilePosition(double distance, double velocity, double acceleration, double elapsed, double& traveled) {
+    double total = OWISPSAxis::estimateMoveTime(distance, velocity, acceleration);
+
+    distance = fabs(distance);
+    if ((total < 0) || (elapsed >= total)) {
+        traveled = distance;
+        return true;
+    }
+    if (elapsed <= 0) {
+        traveled = 0;
+        return false;
+    }
+
+    if (acceleration <= 0) {
+        traveled = velocity*elapsed;
+    } else {
+        double ramp = (distance >= velocity*velocity/acceleration) ? velocity/acceleration : total/2;
+        if (elapsed < ramp) {
+            traveled = acceleration*elapsed*elapsed/2;
+        } else if (elapsed <= total-ramp) {
+            traveled = acceleration*ramp*ramp/2 + acceleration*ramp*(elapsed-ramp);
+        } else {
+            traveled = distance - acceleration*(total-elapsed)*(total-elapsed)/2;
+        }
+    }
+    if (traveled > distance) {
+        traveled = distance;
+    }
+    return false;
+}
+
+
+
+/** Creates a new OWISPSSimulator object.
+  * Configuration command, called directly or from iocsh
+  *
+  * \param[in] portName        The name of the asyn port that will be created for this simulator
+  * \param[in] numAxes         The number of axes of the simulated PS
+  * \param[in] baudRate        The simulated link speed, 0 for an infinitely fast link
+  * \param[in] turnaroundTime  The time between a command and its reply, in microseconds
+  */
+extern "C" int OWISPSCreateSimulator(const char *portName, int numAxes, int baudRate, int turnaroundTime) {
+    new OWISPSSimulator(portName, numAxes, baudRate, turnaroundTime/1000000.);
+    return asynSuccess;
+}
+
+static const iocshArg OWISPSCreateSimulatorArg0 = { "Port name", iocshArgString };
+static const iocshArg OWISPSCreateSimulatorArg1 = { "Number of axes", iocshArgInt };
+static const iocshArg OWISPSCreateSimulatorArg2 = { "Baud rate", iocshArgInt };
+static const iocshArg OWISPSCreateSimulatorArg3 = { "Turnaround time (us)", iocshArgInt };
+static const iocshArg * const OWISPSCreateSimulatorArgs[] = { &OWISPSCreateSimulatorArg0,
+                                                              &OWISPSCreateSimulatorArg1,
+                                                              &OWISPSCreateSimulatorArg2,
+                                                              &OWISPSCreateSimulatorArg3 };
+static const iocshFuncDef OWISPSCreateSimulatorDef = { "OWISPSCreateSimulator", 4, OWISPSCreateSimulatorArgs };
+static void OWISPSCreateSimulatorCallFunc(const iocshArgBuf *args) {
+    OWISPSCreateSimulator(args[0].sval, args[1].ival, args[2].ival, args[3].ival);
+}
+
+static void OWISPSSimulatorRegister(void) {
+    iocshRegister(&OWISPSCreateSimulatorDef, OWISPSCreateSimulatorCallFunc);
+}
+
+extern "C" {
+    epicsExportRegistrar(OWISPSSimulatorRegister);
+}
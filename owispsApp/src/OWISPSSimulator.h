@@ -0,0 +1,89 @@
+/*
+FILENAME...   OWISPSSimulator.h
+USAGE...      Simulated OWIS PS controller, as an asyn octet port, for testing and benchmarking without hardware
+
+Jose G.C. Gabadinho
+October 2026
+*/
+
+#ifndef _OWISPSSIMULATOR_H_
+#define _OWISPSSIMULATOR_H_
+
+#include <asynPortDriver.h>
+
+#include <epicsTime.h>
+
+#include "OWISPSMotorDriver.h"
+
+
+
+#define MAX_OWISPS_SIM_AXES        9  // PS90
+#define MAX_OWISPS_SIM_REPLIES     64 // Replies waiting to be read
+#define OWISPS_SIM_BITS_PER_BYTE   10 // 8N1
+
+#define OWISPS_SIM_DEFAULT_VELOCITY     10000 // Counter steps/s
+#define OWISPS_SIM_DEFAULT_ACCELERATION 50000 // Counter steps/s^2
+#define OWISPS_SIM_VERSION              "OWISPS-SIM 1.0"
+
+
+
+typedef struct {
+    char status;           // ?ASTAT character
+    int coordinateMode;    // OWISPS_COORD_ABSOLUTE or OWISPS_COORD_RELATIVE
+    int velocity;          // PVEL, in counter steps/s
+    int acceleration;      // ACC, in counter steps/s^2
+    int target;            // PSET
+    double position;       // Counter
+    double startPosition;  // Counter when the ongoing move started
+    double distance;       // Signed distance of the ongoing move
+    epicsTimeStamp startTime;
+} owispsSimAxis;
+
+
+
+class OWISPSSimulator: public asynPortDriver {
+
+public:
+    OWISPSSimulator(const char *portName, int numAxes, int baudRate, double turnaroundTime);
+
+    // These are the methods we override from the base class
+    void report(FILE *fp, int level);
+
+    asynStatus writeOctet(asynUser *pasynUser, const char *value, size_t maxChars, size_t *nActual);
+    asynStatus readOctet(asynUser *pasynUser, char *value, size_t maxChars, size_t *nActual, int *eomReason);
+    asynStatus flushOctet(asynUser *pasynUser);
+
+    // Link statistics, for benchmarking
+    void getStatistics(int& writes, int& reads, long& bytes);
+    void resetStatistics(void);
+
+    // Outages, for testing
+    void setAnswering(bool answering);
+
+    // Class-wide methods
+    static bool profilePosition(double distance, double velocity, double acceleration, double elapsed, double& traveled);
+
+protected:
+    virtual void executeCommand(const char *command);
+    virtual void updateAxis(owispsSimAxis *axis, const epicsTimeStamp *now);
+    virtual void startMove(owispsSimAxis *axis, double distance, char status);
+    virtual void queueReply(const char *format, ...);
+    virtual double replyTime(size_t length);
+
+    double byteTime;       // Time to transfer one byte, 0 for an infinitely fast link
+    double turnaroundTime; // Time from command to reply
+    bool answering;        // False to simulate a controller off or disconnected
+
+    int numAxes;
+    owispsSimAxis axes[MAX_OWISPS_SIM_AXES];
+
+    char replies[MAX_OWISPS_SIM_REPLIES][MAX_OWISPS_STRING_SIZE];
+    int replyHead;  // Next reply to be read
+    int replyCount; // Replies waiting to be read
+
+    int writeCount;
+    int readCount;
+    long byteCount; // Bytes transferred both ways, EOS included
+};
+
+#endif // _OWISPSSIMULATOR_H_